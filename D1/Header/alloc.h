@@ -0,0 +1,42 @@
+#ifndef ALLOC_H
+#define ALLOC_H
+
+#include <stddef.h>
+
+// Livello di allocazione condiviso tra D1 e D2: allineamento, huge page
+// trasparenti e politica NUMA per gli array della matrice e dei vettori.
+// La memoria restituita si libera con free()
+
+#define ALLOC_LINE          64              // allineamento minimo (linea di cache)
+#define ALLOC_HUGE_PAGE     (2L << 20)      // huge page x86-64
+
+#define ALLOC_ALIGN_AUTO    0   // 2 MB sopra ALLOC_HUGE_PAGE byte, altrimenti 64
+#define ALLOC_ALIGN_LINE    1   // sempre 64 byte
+#define ALLOC_ALIGN_HUGE    2   // sempre 2 MB
+
+#define ALLOC_NUMA_NONE       0   // first touch del sistema operativo
+#define ALLOC_NUMA_INTERLEAVE 1   // pagine distribuite su tutti i nodi
+#define ALLOC_NUMA_BIND       2   // pagine su un solo nodo
+
+typedef struct {
+    int align_mode;
+    int huge_pages;     // 1 = madvise(MADV_HUGEPAGE) sugli array >= 2 MB
+    int numa_mode;
+    int numa_node;      // nodo per ALLOC_NUMA_BIND
+} AllocPolicy;
+
+// Opzioni --align=auto|64|2M, --thp / --no-thp, --numa=none|interleave|bind[:node]
+// Restituisce 1 se l'opzione è stata riconosciuta, -1 se il valore non è valido, 0 altrimenti
+int alloc_parse_option(const char *arg);
+
+const char* alloc_options_help(void);
+
+void* alloc_array(size_t bytes);
+
+// Come calloc, con azzeramento parallelo (first touch distribuito tra i thread)
+void* alloc_zeroed(size_t count, size_t size);
+
+// Descrizione della politica in uso, es. "align=auto thp=on numa=interleave (2 nodes)"
+const char* alloc_policy_string(void);
+
+#endif
@@ -5,11 +5,92 @@
 
 #include "matrix_io.h"
 
+// Classi di lunghezza delle righe per il kernel "binned"
+#define BIN_SHORT_MAX   8     // righe corte: kernel srotolato a lunghezza fissa
+#define BIN_LONG_MIN    256   // soglia minima per considerare una riga lunga
+#define BIN_LONG_SHARE  4     // lunga se supera 1/(BIN_LONG_SHARE * threads) dei nz
+
+typedef struct {
+    int num_threads;
+    int n_short, n_medium, n_long;
+    int *short_rows;      // indici delle righe corte
+    int *medium_rows;     // indici delle righe medie
+    int *long_rows;       // indici delle righe lunghe
+    int *short_bounds;    // num_threads + 1: partizione bilanciata sui nz
+    int *medium_bounds;   // num_threads + 1: partizione bilanciata sui nz
+} RowBins;
+
+// Piano di esecuzione per SpMV ripetute: intervalli di righe precalcolati
+// per ogni thread, eseguiti dentro un'unica regione parallela persistente
+typedef struct {
+    int num_threads;
+    int schedule_type;
+    int chunk_size;
+    int n_ranges;
+    int *thread_ranges;   // num_threads + 1: primo intervallo di ogni thread
+    int *range_begin;     // riga iniziale di ogni intervallo
+    int *range_end;       // riga finale (esclusa) di ogni intervallo
+    int barrier_count;    // stato della barriera sense-reversing
+    int barrier_sense;
+} SpmvPlan;
+
+// Metodi per y += A^T x sul CSR esistente
+#define TRANSPOSE_AUTO      0   // scelto da csr_transpose_choose
+#define TRANSPOSE_BUFFERS   1   // buffer privati per thread + riduzione
+#define TRANSPOSE_ATOMIC    2   // scatter con omp atomic
+#define TRANSPOSE_CSC       3   // copia CSC in cache: più memoria, nessuna scrittura concorrente
+#define TRANSPOSE_BUFFER_RATIO 4  // buffer privati se threads * N <= ratio * nz
+
+typedef struct {
+    int method;
+    int num_threads;
+    double *buffers;      // num_threads * N (TRANSPOSE_BUFFERS)
+    int *col_ptr;         // N + 1 (TRANSPOSE_CSC)
+    int *row_ind;         // nz, righe ordinate per colonna
+    double *csc_val;      // nz
+} TransposePlan;
+
 void csr_spmv_seq(Matrix *mat, double *x, double *y);
 
 void csr_spmv_parallel_schedule(Matrix *mat, double *x, double *y, 
                                   int num_threads, int schedule_type, int chunk_size);
 
-#endif
+// Kernel fusi: y non va azzerato prima della chiamata
+#define FUSED_NONE   0
+#define FUSED_AXPBY  1   // y = alpha A x + beta y
+#define FUSED_XDOT   2   // y = A x, restituisce x^T A x (A quadrata)
+#define FUSED_NORM2  3   // y = A x, restituisce ||y||^2
+
+void csr_spmv_axpby(Matrix *mat, double alpha, double *x, double beta, double *y,
+                    int num_threads, int schedule_type, int chunk_size);
+
+double csr_spmv_xdot(Matrix *mat, double *x, double *y,
+                     int num_threads, int schedule_type, int chunk_size);
+
+double csr_spmv_norm2(Matrix *mat, double *x, double *y,
+                      int num_threads, int schedule_type, int chunk_size);
+
+RowBins* csr_build_row_bins(Matrix *mat, int num_threads);
 
+void csr_spmv_binned(Matrix *mat, RowBins *bins, double *x, double *y);
 
+void free_row_bins(RowBins *bins);
+
+SpmvPlan* csr_plan_create(Matrix *mat, int num_threads, int schedule_type, int chunk_size);
+
+void csr_plan_execute(SpmvPlan *plan, Matrix *mat, double *x, double *y,
+                      int iterations, double *times);
+
+void free_spmv_plan(SpmvPlan *plan);
+
+int csr_transpose_choose(Matrix *mat, int num_threads);
+
+TransposePlan* csr_transpose_create(Matrix *mat, int num_threads, int method);
+
+void csr_spmv_transpose(TransposePlan *tp, Matrix *mat, double *x, double *y);
+
+const char* transpose_method_name(int method);
+
+void free_transpose_plan(TransposePlan *tp);
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef EIGEN_H
+#define EIGEN_H
+
+#include "matrix_io.h"
+
+// Modalità a catena: l'uscita di ogni SpMV diventa l'ingresso della successiva
+#define EIGEN_NONE     0
+#define EIGEN_POWER    1   // potenze: autovalore di modulo massimo
+#define EIGEN_LANCZOS  2   // Lanczos (A simmetrica): autovalori estremi
+
+typedef struct {
+    int mode;
+    int n;
+    int num_threads, schedule_type, chunk_size;
+    double *v;          // vettore corrente (normalizzato)
+    double *w;          // secondo buffer: y per le potenze, v precedente per Lanczos
+    double beta_prev;   // Lanczos: beta del passo precedente
+    int steps;
+    int max_steps;
+    double *alpha;      // Lanczos: diagonale della tridiagonale
+    double *beta;       // Lanczos: sottodiagonale
+    double lambda;      // potenze: quoziente di Rayleigh dell'ultimo passo
+    int breakdown;      // Lanczos: beta ~ 0, sottospazio invariante trovato
+} EigenState;
+
+EigenState* eigen_create(Matrix *mat, int mode, int max_steps,
+                         int num_threads, int schedule_type, int chunk_size);
+
+// Un passo: una SpMV più le operazioni vettoriali di normalizzazione
+void eigen_step(EigenState *es, Matrix *mat);
+
+void eigen_estimate(EigenState *es, double *lambda_min, double *lambda_max);
+
+const char* eigen_mode_name(int mode);
+
+void free_eigen_state(EigenState *es);
+
+#endif
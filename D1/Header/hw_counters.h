@@ -0,0 +1,46 @@
+
+
+#ifndef HW_COUNTERS_H
+#define HW_COUNTERS_H
+
+#include "matrix_io.h"
+
+// Eventi raccolti con perf_event_open (un gruppo per thread, leader = cicli)
+#define HWC_CYCLES        0
+#define HWC_INSTRUCTIONS  1
+#define HWC_L1D_MISSES    2   // L1D read miss
+#define HWC_LLC_MISSES    3   // LLC read miss
+#define HWC_LLC_WMISSES   4   // LLC write miss (traffico verso la DRAM)
+#define HWC_NUM_EVENTS    5
+
+#define HWC_CACHE_LINE    64
+
+typedef struct {
+    int num_threads;
+    int available;                      // 0 se perf_event_open non è utilizzabile
+    int *fds;                           // num_threads * HWC_NUM_EVENTS, -1 se assente
+    int *slot;                          // posizione di ogni evento nel gruppo del thread
+    int event_ok[HWC_NUM_EVENTS];       // evento aperto su tutti i thread
+    long long values[HWC_NUM_EVENTS];   // somma sui thread, scalata per il multiplexing
+} HwCounters;
+
+HwCounters* hwc_open(int num_threads);
+
+void hwc_start(HwCounters *hwc);
+
+void hwc_stop(HwCounters *hwc);
+
+void hwc_read(HwCounters *hwc);
+
+void hwc_close(HwCounters *hwc);
+
+// Byte minimi trasferiti da una SpMV CSR (val, colonne, prefixSum, x, y letto e scritto)
+double spmv_bytes_moved(Matrix *mat);
+
+// Banda STREAM triad misurata con num_threads thread, in GB/s
+double hwc_stream_bandwidth(int num_threads);
+
+void hwc_print_roofline(HwCounters *hwc, Matrix *mat, int iterations,
+                        double total_time, double stream_bw);
+
+#endif
@@ -3,22 +3,28 @@
 #ifndef MATRIX_IO_H
 #define MATRIX_IO_H
 
+#include <stddef.h>
+
 typedef struct {
     int M;              // righe
     int N;              // colonne
     int nz;             // non-zero
     int is_symmetric;
-    int *I, *J;         // coordinate COO
-    double *val;        // valori
+    int *I, *J;         // coordinate COO (NULL dopo coo_to_csr)
+    double *val;        // valori (NULL dopo coo_to_csr)
     int *prefixSum;     // CSR prefix
     int *sorted_J;      // CSR colonne ordinate
     double *sorted_val; // CSR valori ordinati
+    void *arena;        // unica allocazione per prefixSum, sorted_J, sorted_val
+    size_t arena_bytes;
 } Matrix;
 
 Matrix* read_matrix(const char *filename);
 
 void coo_to_csr(Matrix *mat);
 
+// Picco di memoria residente del processo (getrusage)
+double peak_rss_mb(void);
 
 void free_matrix(Matrix *mat);
 
@@ -0,0 +1,76 @@
+#ifndef OOC_H
+#define OOC_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+// SpMV out-of-core: la matrice resta su disco in un file binario a blocchi di
+// righe e viene letta blocco per blocco mentre si calcola; x e y restano in RAM
+
+#define OOC_MAGIC            "SPMVOOC2"
+#define OOC_DEFAULT_BLOCK_MB 32        // dimensione obiettivo di un blocco su disco
+#ifndef OOC_CONVERT_BUDGET
+#define OOC_CONVERT_BUDGET   (1L << 30) // RAM usata per passata dal convertitore
+#endif
+
+// Layout del file:
+//   OocHeader
+//   OocBlockInfo[n_blocks]
+//   per ogni blocco: row_ptr (int32, rows + 1, relativo al blocco),
+//                    col (int32, nnz), val (double, nnz)
+typedef struct {
+    char magic[8];
+    int64_t M, N, nnz;
+    int64_t n_blocks;
+    // Provenienza: un file costruito da un altro .mtx (o dallo stesso .mtx
+    // modificato) o con un'altra dimensione di blocco va ricostruito
+    int64_t nnz_file;           // nonzeri dichiarati nel .mtx, prima della simmetria
+    int64_t source_bytes, source_mtime;
+    int64_t block_bytes;        // obiettivo di --ooc-block usato nella conversione
+} OocHeader;
+
+typedef struct {
+    int64_t row_begin, row_end;
+    int64_t nnz;
+    int64_t offset;     // posizione del blocco nel file
+    int64_t bytes;
+} OocBlockInfo;
+
+typedef struct {
+    int fd;
+    OocHeader hdr;
+    OocBlockInfo *blocks;
+    int64_t max_block_bytes;
+
+    // Doppio buffer: il thread di lettura riempie uno mentre si calcola sull'altro
+    char *buffers[2];
+    int ready[2];           // indice del blocco presente nel buffer, -1 se libero
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+
+    // Statistiche dell'ultima chiamata
+    double read_time;       // tempo passato dal thread di lettura in pread
+    double wait_time;       // tempo in cui il calcolo ha atteso i dati
+    double bytes_read;
+} OocMatrix;
+
+// Converte un file Matrix Market nel formato a blocchi senza caricarlo tutto:
+// una passata per contare, poi passate successive limitate a OOC_CONVERT_BUDGET
+int ooc_convert_mtx(const char *mtx_file, const char *ooc_file, long block_bytes);
+
+// Provenienza attesa per mtx_file e block_bytes (M, N, nnz_file, dimensione,
+// mtime, blocco) in *src; 0 se il .mtx non è leggibile
+int ooc_source_info(const char *mtx_file, long block_bytes, OocHeader *src);
+
+// 1 se il file aperto è stato costruito con la provenienza src
+int ooc_matches(const OocMatrix *om, const OocHeader *src);
+
+OocMatrix* ooc_open(const char *ooc_file);
+
+// y = A x; ogni blocco è moltiplicato da num_threads thread con lo schedule dato
+void ooc_spmv(OocMatrix *om, double *x, double *y, int num_threads,
+              int schedule_type, int chunk_size);
+
+void ooc_close(OocMatrix *om);
+
+#endif
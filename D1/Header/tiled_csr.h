@@ -0,0 +1,36 @@
+
+
+#ifndef TILED_CSR_H
+#define TILED_CSR_H
+
+#include "matrix_io.h"
+
+#define TILED_DEFAULT_CACHE (256 * 1024)   // se la cache non è rilevabile
+
+// CSR a pannelli di colonne: ogni pannello copre panel_width colonne, in modo
+// che la porzione di x letta resti in cache. Per pannello si memorizzano solo
+// le righe con almeno un elemento: le voci panel_start[p]..panel_start[p+1]
+// di rows/row_ptr, con row_ptr[e]..row_ptr[e+1] gli elementi della voce e
+typedef struct {
+    int M, N;
+    int nz;
+    int panel_width;
+    int n_panels;
+    int n_entries;      // righe non vuote, sommate su tutti i pannelli
+    int *panel_start;   // n_panels + 1
+    int *rows;          // n_entries: riga di ogni voce
+    int *row_ptr;       // n_entries + 1: offset assoluti in col/val
+    int *col;           // colonne, pannello dopo pannello
+    double *val;
+} TiledCSR;
+
+// Dimensione in byte della cache su cui dimensionare i pannelli (L2)
+long detect_cache_size(void);
+
+TiledCSR* csr_build_tiled(Matrix *mat, long cache_bytes);
+
+void csr_spmv_tiled(TiledCSR *t, double *x, double *y, int num_threads, int chunk_size);
+
+void free_tiled_csr(TiledCSR *t);
+
+#endif
@@ -0,0 +1,41 @@
+
+
+#ifndef TUNER_H
+#define TUNER_H
+
+#include "matrix_io.h"
+
+// Kernel candidati
+#define TUNE_KERNEL_CSR     0   // csr_spmv_parallel_schedule
+#define TUNE_KERNEL_BINNED  1   // csr_spmv_binned
+#define TUNE_KERNEL_PLAN    2   // csr_plan_execute
+#define TUNE_KERNEL_TILED   3   // csr_spmv_tiled (pannelli di colonne)
+#define TUNE_KERNEL_DIA     4   // dia_spmv (diagonali + resto CSR)
+
+#define TUNE_TRIALS 5           // ripetizioni per candidato (si usa la mediana)
+
+typedef struct {
+    double row_mean;        // nz medi per riga
+    double row_std;         // deviazione standard dei nz per riga
+    int row_min, row_max;
+    int empty_rows;
+    int bandwidth;          // max |i - j|
+    double block_density;   // riempimento medio dei blocchi 4x4 non vuoti
+} MatrixFeatures;
+
+typedef struct {
+    int kernel;
+    int schedule;           // 0 static, 1 dynamic, 2 guided
+    int chunk_size;
+    int num_threads;
+    double time;            // tempo mediano misurato per una SpMV
+} TuneConfig;
+
+void extract_matrix_features(Matrix *mat, MatrixFeatures *f);
+
+// Restituisce 1 se la configurazione viene dalla cache, 0 se è stata cercata
+int autotune(Matrix *mat, const char *matrix_file, int max_threads, TuneConfig *best);
+
+const char* tune_kernel_name(int kernel);
+
+#endif
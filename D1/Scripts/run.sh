@@ -2,7 +2,7 @@
 
 
 mkdir -p ../Results
-SRC="../Src/main.c ../Src/matrix_io.c ../Src/csr.c ../Src/mmio.c"
+SRC="../Src/main.c ../Src/matrix_io.c ../Src/csr.c ../Src/mmio.c ../Src/tuner.c ../Src/hw_counters.c ../Src/bench.c ../Src/tiled_csr.c ../Src/dia.c ../Src/ooc.c ../Src/alloc.c ../Src/tridiag.c ../Src/eigen.c"
 TIME_OUTPUT="../Results/results_time.csv"
 PERF_OUTPUT="../Results/results_perf.csv"
 MATRIX_DIR="../Matrix"
@@ -21,7 +21,7 @@ echo "matrix,mode,schedule,chunk_size,num_threads,run_number,l1_loads,l1_misses,
 
 echo "════════ COMPILAZIONE ══════"
 echo "[Compilazione modalità time]"
-gcc -O3 ${CFLAGS_BASE} -o ./matvec $SRC 2>/dev/null
+gcc -O3 ${CFLAGS_BASE} -o ./matvec $SRC -lm 2>/dev/null
 if [ $? -ne 0 ]; then
     echo "✗ Compilazione modalità time fallita!"
     exit 1
@@ -29,7 +29,7 @@ fi
 echo "✓ OK"
 
 echo "[Compilazione modalità perf]"
-gcc -O3 ${CFLAGS_BASE} -DPERF_MODE -o ./matvec_perf $SRC 2>/dev/null
+gcc -O3 ${CFLAGS_BASE} -DPERF_MODE -o ./matvec_perf $SRC -lm 2>/dev/null
 if [ $? -ne 0 ]; then
     echo "✗ Compilazione modalità perf fallita!"
     exit 1
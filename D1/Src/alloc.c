@@ -0,0 +1,156 @@
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "alloc.h"
+
+// Modalità di mbind(2): si evita la dipendenza da libnuma
+#define MPOL_BIND_MODE        2
+#define MPOL_INTERLEAVE_MODE  3
+#define ALLOC_MAX_NODES       64
+
+static AllocPolicy policy = { ALLOC_ALIGN_AUTO, 1, ALLOC_NUMA_NONE, 0 };
+static int numa_failed = 0;     // mbind non disponibile o rifiutato
+static char policy_text[128];
+
+int alloc_parse_option(const char *arg) {
+    if (strncmp(arg, "--align=", 8) == 0) {
+        const char *v = arg + 8;
+        if (strcmp(v, "auto") == 0) policy.align_mode = ALLOC_ALIGN_AUTO;
+        else if (strcmp(v, "64") == 0) policy.align_mode = ALLOC_ALIGN_LINE;
+        else if (strcmp(v, "2M") == 0) policy.align_mode = ALLOC_ALIGN_HUGE;
+        else return -1;
+        return 1;
+    }
+    if (strcmp(arg, "--thp") == 0) {
+        policy.huge_pages = 1;
+        return 1;
+    }
+    if (strcmp(arg, "--no-thp") == 0) {
+        policy.huge_pages = 0;
+        return 1;
+    }
+    if (strncmp(arg, "--numa=", 7) == 0) {
+        const char *v = arg + 7;
+        if (strcmp(v, "none") == 0) {
+            policy.numa_mode = ALLOC_NUMA_NONE;
+        } else if (strcmp(v, "interleave") == 0) {
+            policy.numa_mode = ALLOC_NUMA_INTERLEAVE;
+        } else if (strncmp(v, "bind", 4) == 0) {
+            policy.numa_mode = ALLOC_NUMA_BIND;
+            policy.numa_node = 0;
+            if (v[4] == ':') policy.numa_node = atoi(v + 5);
+            else if (v[4] != '\0') return -1;
+            if (policy.numa_node < 0 || policy.numa_node >= ALLOC_MAX_NODES) return -1;
+        } else {
+            return -1;
+        }
+        return 1;
+    }
+    return 0;
+}
+
+const char* alloc_options_help(void) {
+    return "           --align=auto|64|2M  --thp|--no-thp  --numa=none|interleave|bind[:node]\n";
+}
+
+// Numero di nodi NUMA da sysfs ("0" oppure "0-3"); 1 se non disponibile
+static int numa_node_count(void) {
+    FILE *f = fopen("/sys/devices/system/node/online", "r");
+    int first = 0, last = 0;
+    if (!f) return 1;
+    int n = fscanf(f, "%d-%d", &first, &last);
+    fclose(f);
+    if (n == 2 && last >= first) return last + 1 < ALLOC_MAX_NODES ? last + 1 : ALLOC_MAX_NODES;
+    return 1;
+}
+
+static void apply_numa(void *p, size_t bytes) {
+    if (policy.numa_mode == ALLOC_NUMA_NONE || numa_failed) return;
+
+    unsigned long mask = 0;
+    int mode;
+    if (policy.numa_mode == ALLOC_NUMA_INTERLEAVE) {
+        int nodes = numa_node_count();
+        mask = nodes >= 64 ? ~0UL : (1UL << nodes) - 1;
+        mode = MPOL_INTERLEAVE_MODE;
+    } else {
+        mask = 1UL << policy.numa_node;
+        mode = MPOL_BIND_MODE;
+    }
+
+#ifdef SYS_mbind
+    if (syscall(SYS_mbind, p, bytes, mode, &mask, (unsigned long)ALLOC_MAX_NODES + 1, 0) != 0) {
+        numa_failed = 1;
+    }
+#else
+    (void)p; (void)bytes; (void)mode; (void)mask;
+    numa_failed = 1;
+#endif
+}
+
+void* alloc_array(size_t bytes) {
+    size_t align = ALLOC_LINE;
+    if (policy.align_mode == ALLOC_ALIGN_HUGE ||
+        (policy.align_mode == ALLOC_ALIGN_AUTO && bytes >= (size_t)ALLOC_HUGE_PAGE)) {
+        align = ALLOC_HUGE_PAGE;
+    }
+
+    // Dimensione arrotondata all'allineamento: madvise e mbind lavorano a pagine intere
+    size_t rounded = (bytes + align - 1) / align * align;
+    if (rounded == 0) rounded = align;
+
+    void *p = NULL;
+    if (posix_memalign(&p, align, rounded) != 0) {
+        fprintf(stderr, "Error: cannot allocate %zu bytes\n", bytes);
+        exit(1);
+    }
+
+    // Politiche applicate prima del primo accesso alle pagine; madvise e
+    // mbind richiedono indirizzi allineati alla pagina
+    if (align == (size_t)ALLOC_HUGE_PAGE) {
+#ifdef MADV_HUGEPAGE
+        if (policy.huge_pages) madvise(p, rounded, MADV_HUGEPAGE);
+#endif
+        apply_numa(p, rounded);
+    }
+    return p;
+}
+
+void* alloc_zeroed(size_t count, size_t size) {
+    size_t bytes = count * size;
+    char *p = (char*)alloc_array(bytes);
+
+    // Ogni thread azzera (e quindi alloca) il suo blocco, con la stessa
+    // ripartizione statica dei kernel
+    long n_pages = (long)((bytes + 4095) / 4096);
+    #pragma omp parallel for schedule(static)
+    for (long pg = 0; pg < n_pages; pg++) {
+        size_t begin = (size_t)pg * 4096;
+        size_t len = begin + 4096 <= bytes ? 4096 : bytes - begin;
+        memset(p + begin, 0, len);
+    }
+    return p;
+}
+
+const char* alloc_policy_string(void) {
+    const char *align = policy.align_mode == ALLOC_ALIGN_LINE ? "64" :
+                        policy.align_mode == ALLOC_ALIGN_HUGE ? "2M" : "auto";
+    char numa[48];
+    if (policy.numa_mode == ALLOC_NUMA_INTERLEAVE) {
+        snprintf(numa, sizeof(numa), "interleave (%d nodes)", numa_node_count());
+    } else if (policy.numa_mode == ALLOC_NUMA_BIND) {
+        snprintf(numa, sizeof(numa), "bind:%d", policy.numa_node);
+    } else {
+        snprintf(numa, sizeof(numa), "none");
+    }
+    snprintf(policy_text, sizeof(policy_text), "align=%s thp=%s numa=%s%s", align,
+             policy.huge_pages ? "on" : "off", numa, numa_failed ? " (mbind failed)" : "");
+    return policy_text;
+}
@@ -0,0 +1,212 @@
+
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "bench.h"
+
+static double *flush_buffer = NULL;
+static long flush_elems = 0;
+
+void bench_default_config(BenchConfig *cfg) {
+    cfg->target_time = BENCH_DEFAULT_TARGET;
+    cfg->warmup = BENCH_DEFAULT_WARMUP;
+    cfg->min_iters = BENCH_DEFAULT_MIN;
+    cfg->max_iters = BENCH_DEFAULT_MAX;
+    cfg->flush_cache = 0;
+    cfg->json_path = NULL;
+    cfg->csv_path = NULL;
+}
+
+int bench_parse_option(BenchConfig *cfg, const char *arg) {
+    if (strncmp(arg, "--bench-time=", 13) == 0) {
+        cfg->target_time = atof(arg + 13);
+        return cfg->target_time >= 0.0 ? 1 : -1;
+    }
+    if (strncmp(arg, "--warmup=", 9) == 0) {
+        cfg->warmup = atoi(arg + 9);
+        return cfg->warmup >= 0 ? 1 : -1;
+    }
+    if (strncmp(arg, "--min-iters=", 12) == 0) {
+        cfg->min_iters = atoi(arg + 12);
+        return cfg->min_iters > 0 ? 1 : -1;
+    }
+    if (strncmp(arg, "--max-iters=", 12) == 0) {
+        cfg->max_iters = atoi(arg + 12);
+        return cfg->max_iters > 0 ? 1 : -1;
+    }
+    if (strcmp(arg, "--cold") == 0) {
+        cfg->flush_cache = 1;
+        return 1;
+    }
+    if (strcmp(arg, "--warm") == 0) {
+        cfg->flush_cache = 0;
+        return 1;
+    }
+    if (strncmp(arg, "--bench-json=", 13) == 0) {
+        cfg->json_path = arg + 13;
+        return 1;
+    }
+    if (strncmp(arg, "--bench-csv=", 12) == 0) {
+        cfg->csv_path = arg + 12;
+        return 1;
+    }
+    return 0;
+}
+
+const char* bench_options_help(void) {
+    return "           --bench-time=<s> --warmup=<n> --min-iters=<n> --max-iters=<n>\n"
+           "           --cold|--warm  --bench-json=<file> --bench-csv=<file>\n";
+}
+
+int bench_iterations_for(const BenchConfig *cfg, double pilot_time) {
+    int max_iters = cfg->max_iters > cfg->min_iters ? cfg->max_iters : cfg->min_iters;
+    if (cfg->target_time <= 0.0 || pilot_time <= 0.0) return cfg->min_iters;
+
+    double n = cfg->target_time / pilot_time;
+    if (n < cfg->min_iters) return cfg->min_iters;
+    if (n > max_iters) return max_iters;
+    return (int)n;
+}
+
+void bench_flush_cache(void) {
+    if (!flush_buffer) {
+        // Almeno il doppio della LLC, così nessun dato della SpMV sopravvive
+        long bytes = BENCH_FLUSH_MIN_BYTES;
+        long llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+        if (llc > 0 && 2 * llc > bytes) bytes = 2 * llc;
+        flush_elems = bytes / (long)sizeof(double);
+        flush_buffer = (double*)calloc(flush_elems, sizeof(double));
+        if (!flush_buffer) {
+            flush_elems = 0;
+            return;
+        }
+    }
+
+    // Lettura e scrittura da tutti i thread: svuota anche le cache private
+    #pragma omp parallel for schedule(static)
+    for (long i = 0; i < flush_elems; i++) {
+        flush_buffer[i] += 1.0;
+    }
+}
+
+static int compare_times(const void *a, const void *b) {
+    double diff = (*(double*)a - *(double*)b);
+    if (diff > 0) return 1;
+    if (diff < 0) return -1;
+    return 0;
+}
+
+double bench_percentile(const double *sorted, int n, double p) {
+    if (n <= 0) return 0.0;
+    if (n == 1) return sorted[0];
+
+    double k = p * n;
+    int index = (int)k;
+    // k intero: media tra il k-esimo e il (k+1)-esimo valore
+    if (k == (double)index && index > 0 && index < n)
+        return (sorted[index - 1] + sorted[index]) / 2.0;
+    // altrimenti rango ceil(k), convertito in indice 0-based
+    if (k != (double)index) index = (int)k + 1;
+    if (index > n) index = n;
+    if (index < 1) index = 1;
+    return sorted[index - 1];
+}
+
+void bench_compute_stats(const double *times, int n, BenchStats *s) {
+    memset(s, 0, sizeof(*s));
+    s->n = n;
+    if (n <= 0) return;
+
+    double *sorted = (double*)malloc(n * sizeof(double));
+    memcpy(sorted, times, n * sizeof(double));
+    qsort(sorted, n, sizeof(double), compare_times);
+
+    double sum = 0.0;
+    for (int i = 0; i < n; i++) sum += sorted[i];
+
+    s->min = sorted[0];
+    s->max = sorted[n - 1];
+    s->mean = sum / n;
+    s->median = bench_percentile(sorted, n, 0.50);
+    s->p90 = bench_percentile(sorted, n, 0.90);
+    s->p99 = bench_percentile(sorted, n, 0.99);
+
+    // IC non parametrico della mediana: ranghi n/2 -+ 1.96 sqrt(n)/2
+    double half = 1.96 * sqrt((double)n) / 2.0;
+    int lo = (int)floor(n / 2.0 - half);
+    int hi = (int)ceil(n / 2.0 + half);
+    if (lo < 0) lo = 0;
+    if (hi > n - 1) hi = n - 1;
+    s->ci_low = sorted[lo];
+    s->ci_high = sorted[hi];
+
+    free(sorted);
+}
+
+void bench_print_stats(const char *label, const BenchStats *s) {
+    fprintf(stderr, "[BENCH] %s: n=%d min=%.9f median=%.9f p90=%.9f p99=%.9f "
+                    "mean=%.9f max=%.9f ci95=[%.9f %.9f]\n",
+            label, s->n, s->min, s->median, s->p90, s->p99, s->mean, s->max,
+            s->ci_low, s->ci_high);
+}
+
+static int file_is_empty(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) return 1;
+    int empty = (fgetc(f) == EOF);
+    fclose(f);
+    return empty;
+}
+
+void bench_write_results(const BenchConfig *cfg, const char *label, const char *config,
+                         const BenchStats *s, double flops, double bytes) {
+    double gflops = s->median > 0.0 ? flops / s->median / 1e9 : 0.0;
+    double gflops_p90 = s->p90 > 0.0 ? flops / s->p90 / 1e9 : 0.0;
+    double gbs = s->median > 0.0 ? bytes / s->median / 1e9 : 0.0;
+    double gbs_p90 = s->p90 > 0.0 ? bytes / s->p90 / 1e9 : 0.0;
+    const char *cache = cfg->flush_cache ? "cold" : "warm";
+
+    if (cfg->json_path) {
+        FILE *f = fopen(cfg->json_path, "a");
+        if (f) {
+            fprintf(f, "{\"label\": \"%s\", \"config\": \"%s\", \"iterations\": %d, \"warmup\": %d, "
+                       "\"cache\": \"%s\", \"min\": %.9f, \"median\": %.9f, \"mean\": %.9f, "
+                       "\"p90\": %.9f, \"p99\": %.9f, \"max\": %.9f, \"ci95_low\": %.9f, "
+                       "\"ci95_high\": %.9f, \"flops\": %.0f, \"bytes\": %.0f, "
+                       "\"gflops_median\": %.6f, \"gflops_p90\": %.6f, "
+                       "\"bandwidth_gbs_median\": %.6f, \"bandwidth_gbs_p90\": %.6f}\n",
+                    label, config, s->n, cfg->warmup, cache, s->min, s->median, s->mean,
+                    s->p90, s->p99, s->max, s->ci_low, s->ci_high, flops, bytes,
+                    gflops, gflops_p90, gbs, gbs_p90);
+            fclose(f);
+        } else {
+            fprintf(stderr, "Warning: cannot write %s\n", cfg->json_path);
+        }
+    }
+
+    if (cfg->csv_path) {
+        int header = file_is_empty(cfg->csv_path);
+        FILE *f = fopen(cfg->csv_path, "a");
+        if (f) {
+            if (header) {
+                fprintf(f, "label,config,iterations,warmup,cache,min,median,mean,p90,p99,max,"
+                           "ci95_low,ci95_high,flops,bytes,gflops_median,gflops_p90,"
+                           "bandwidth_gbs_median,bandwidth_gbs_p90\n");
+            }
+            fprintf(f, "%s,%s,%d,%d,%s,%.9f,%.9f,%.9f,%.9f,%.9f,%.9f,%.9f,%.9f,%.0f,%.0f,"
+                       "%.6f,%.6f,%.6f,%.6f\n",
+                    label, config, s->n, cfg->warmup, cache, s->min, s->median, s->mean,
+                    s->p90, s->p99, s->max, s->ci_low, s->ci_high, flops, bytes,
+                    gflops, gflops_p90, gbs, gbs_p90);
+            fclose(f);
+        } else {
+            fprintf(stderr, "Warning: cannot write %s\n", cfg->csv_path);
+        }
+    }
+}
@@ -1,48 +1,521 @@
 
 
 
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sched.h>
 #include <omp.h>
 
 #include "csr.h"
+#include "my_timer.h"
+
+// Prodotto scalare di una riga: l'accumulo resta in un registro e restrict
+// esclude l'aliasing tra val, col e x, così il ciclo si può vettorizzare
+static inline double csr_row_dot(int begin, int end, const int *restrict col,
+                                 const double *restrict val, const double *restrict x) {
+    double sum = 0.0;
+    for (int k = begin; k < end; k++) {
+        sum += val[k] * x[col[k]];
+    }
+    return sum;
+}
 
 void csr_spmv_seq(Matrix *mat, double *x, double *y) {
+    const int *restrict rp = mat->prefixSum;
+    double *restrict yr = y;
     for(int i = 0; i < mat->M; i++) {
-        for(int k = mat->prefixSum[i]; k < mat->prefixSum[i + 1]; k++) {
-            y[i] += mat->sorted_val[k] * x[mat->sorted_J[k]];
-        }
+        yr[i] += csr_row_dot(rp[i], rp[i + 1], mat->sorted_J, mat->sorted_val, x);
     }
 }
 
+#define CSR_PRAGMA(x) _Pragma(#x)
+
+// Famiglia di kernel CSR generata una volta per ogni schedule OpenMP: y viene
+// scritto una sola volta per riga (niente y[i] += nel ciclo interno, niente
+// false sharing ripetuto con chunk piccoli)
+#define CSR_KERNEL_FAMILY(KIND)                                                                 \
+static void spmv_##KIND(int n, const int *restrict rp, const int *restrict col,                 \
+                        const double *restrict val, const double *restrict x,                   \
+                        double *restrict y, int num_threads, int chunk_size) {                  \
+    CSR_PRAGMA(omp parallel for num_threads(num_threads) schedule(KIND, chunk_size))            \
+    for (int i = 0; i < n; i++) {                                                               \
+        y[i] += csr_row_dot(rp[i], rp[i + 1], col, val, x);                                     \
+    }                                                                                           \
+}                                                                                               \
+                                                                                                \
+static void axpby_##KIND(int n, const int *restrict rp, const int *restrict col,                \
+                         const double *restrict val, double alpha, const double *restrict x,    \
+                         double beta, double *restrict y, int num_threads, int chunk_size) {    \
+    CSR_PRAGMA(omp parallel for num_threads(num_threads) schedule(KIND, chunk_size))            \
+    for (int i = 0; i < n; i++) {                                                               \
+        double sum = csr_row_dot(rp[i], rp[i + 1], col, val, x);                                \
+        y[i] = (beta == 0.0) ? alpha * sum : alpha * sum + beta * y[i];                         \
+    }                                                                                           \
+}                                                                                               \
+                                                                                                \
+static double xdot_##KIND(int n, const int *restrict rp, const int *restrict col,               \
+                          const double *restrict val, const double *restrict x,                 \
+                          double *restrict y, int num_threads, int chunk_size) {                \
+    double dot = 0.0;                                                                           \
+    CSR_PRAGMA(omp parallel for num_threads(num_threads) schedule(KIND, chunk_size)             \
+               reduction(+:dot))                                                                \
+    for (int i = 0; i < n; i++) {                                                               \
+        double sum = csr_row_dot(rp[i], rp[i + 1], col, val, x);                                \
+        y[i] = sum;                                                                             \
+        dot += x[i] * sum;                                                                      \
+    }                                                                                           \
+    return dot;                                                                                 \
+}                                                                                               \
+                                                                                                \
+static double norm2_##KIND(int n, const int *restrict rp, const int *restrict col,              \
+                           const double *restrict val, const double *restrict x,                \
+                           double *restrict y, int num_threads, int chunk_size) {               \
+    double norm2 = 0.0;                                                                         \
+    CSR_PRAGMA(omp parallel for num_threads(num_threads) schedule(KIND, chunk_size)             \
+               reduction(+:norm2))                                                              \
+    for (int i = 0; i < n; i++) {                                                               \
+        double sum = csr_row_dot(rp[i], rp[i + 1], col, val, x);                                \
+        y[i] = sum;                                                                             \
+        norm2 += sum * sum;                                                                     \
+    }                                                                                           \
+    return norm2;                                                                               \
+}
+
+CSR_KERNEL_FAMILY(static)
+CSR_KERNEL_FAMILY(dynamic)
+CSR_KERNEL_FAMILY(guided)
+
+// Tabelle indicizzate da schedule_type: 0 static, 1 dynamic, 2 guided
+typedef void (*spmv_kernel_t)(int, const int*, const int*, const double*, const double*,
+                              double*, int, int);
+typedef void (*axpby_kernel_t)(int, const int*, const int*, const double*, double,
+                               const double*, double, double*, int, int);
+typedef double (*reduce_kernel_t)(int, const int*, const int*, const double*, const double*,
+                                  double*, int, int);
+
+static const spmv_kernel_t spmv_kernels[3] = { spmv_static, spmv_dynamic, spmv_guided };
+static const axpby_kernel_t axpby_kernels[3] = { axpby_static, axpby_dynamic, axpby_guided };
+static const reduce_kernel_t xdot_kernels[3] = { xdot_static, xdot_dynamic, xdot_guided };
+static const reduce_kernel_t norm2_kernels[3] = { norm2_static, norm2_dynamic, norm2_guided };
+
+#define CSR_VALID_SCHEDULE(s) ((s) >= 0 && (s) <= 2)
+
 void csr_spmv_parallel_schedule(Matrix *mat, double *x, double *y, 
                                   int num_threads, int schedule_type, int chunk_size) {
-    switch (schedule_type) {
-        case 0:  // static
-            #pragma omp parallel for num_threads(num_threads) schedule(static, chunk_size)
-            for(int i = 0; i < mat->M; i++) {
-                for(int k = mat->prefixSum[i]; k < mat->prefixSum[i + 1]; k++) {
-                    y[i] += mat->sorted_val[k] * x[mat->sorted_J[k]];
-                }
+    if (!CSR_VALID_SCHEDULE(schedule_type)) return;
+    spmv_kernels[schedule_type](mat->M, mat->prefixSum, mat->sorted_J, mat->sorted_val,
+                                x, y, num_threads, chunk_size);
+}
+
+void csr_spmv_axpby(Matrix *mat, double alpha, double *x, double beta, double *y,
+                    int num_threads, int schedule_type, int chunk_size) {
+    // Con beta = 0 y non viene letto: non serve azzerarlo prima
+    if (!CSR_VALID_SCHEDULE(schedule_type)) return;
+    axpby_kernels[schedule_type](mat->M, mat->prefixSum, mat->sorted_J, mat->sorted_val,
+                                 alpha, x, beta, y, num_threads, chunk_size);
+}
+
+double csr_spmv_xdot(Matrix *mat, double *x, double *y,
+                     int num_threads, int schedule_type, int chunk_size) {
+    if (!CSR_VALID_SCHEDULE(schedule_type)) return 0.0;
+    return xdot_kernels[schedule_type](mat->M, mat->prefixSum, mat->sorted_J, mat->sorted_val,
+                                       x, y, num_threads, chunk_size);
+}
+
+double csr_spmv_norm2(Matrix *mat, double *x, double *y,
+                      int num_threads, int schedule_type, int chunk_size) {
+    if (!CSR_VALID_SCHEDULE(schedule_type)) return 0.0;
+    return norm2_kernels[schedule_type](mat->M, mat->prefixSum, mat->sorted_J, mat->sorted_val,
+                                        x, y, num_threads, chunk_size);
+}
+
+// Partiziona le righe di una classe in num_threads intervalli con circa
+// lo stesso numero di nz (+1 per riga, per il costo fisso del ciclo)
+static void balance_bin(Matrix *mat, int *rows, int n, int num_threads, int *bounds) {
+    long long total = 0;
+    for (int b = 0; b < n; b++) {
+        int i = rows[b];
+        total += mat->prefixSum[i + 1] - mat->prefixSum[i] + 1;
+    }
+
+    int t = 1;
+    long long acc = 0;
+    bounds[0] = 0;
+    for (int b = 0; b < n && t < num_threads; b++) {
+        int i = rows[b];
+        acc += mat->prefixSum[i + 1] - mat->prefixSum[i] + 1;
+        while (t < num_threads && acc * num_threads >= total * t) {
+            bounds[t++] = b + 1;
+        }
+    }
+    while (t <= num_threads) {
+        bounds[t++] = n;
+    }
+}
+
+RowBins* csr_build_row_bins(Matrix *mat, int num_threads) {
+    RowBins *bins = (RowBins*)malloc(sizeof(RowBins));
+    bins->num_threads = num_threads;
+    bins->n_short = bins->n_medium = bins->n_long = 0;
+
+    // Soglia per le righe lunghe: una riga che da sola occupa una frazione
+    // significativa del lavoro di un thread viene ridotta in parallelo
+    long long long_min = (long long)mat->nz / ((long long)BIN_LONG_SHARE * num_threads);
+    if (long_min < BIN_LONG_MIN) long_min = BIN_LONG_MIN;
+    if (num_threads == 1) long_min = (long long)mat->nz + 1;
+
+    // Prima passata: conta le righe per classe
+    for (int i = 0; i < mat->M; i++) {
+        int len = mat->prefixSum[i + 1] - mat->prefixSum[i];
+        if (len <= BIN_SHORT_MAX) bins->n_short++;
+        else if (len < long_min) bins->n_medium++;
+        else bins->n_long++;
+    }
+
+    bins->short_rows = (int*)malloc((bins->n_short + 1) * sizeof(int));
+    bins->medium_rows = (int*)malloc((bins->n_medium + 1) * sizeof(int));
+    bins->long_rows = (int*)malloc((bins->n_long + 1) * sizeof(int));
+
+    // Seconda passata: riempie le classi mantenendo l'ordine delle righe
+    int s = 0, m = 0, l = 0;
+    for (int i = 0; i < mat->M; i++) {
+        int len = mat->prefixSum[i + 1] - mat->prefixSum[i];
+        if (len <= BIN_SHORT_MAX) bins->short_rows[s++] = i;
+        else if (len < long_min) bins->medium_rows[m++] = i;
+        else bins->long_rows[l++] = i;
+    }
+
+    bins->short_bounds = (int*)malloc((num_threads + 1) * sizeof(int));
+    bins->medium_bounds = (int*)malloc((num_threads + 1) * sizeof(int));
+    balance_bin(mat, bins->short_rows, bins->n_short, num_threads, bins->short_bounds);
+    balance_bin(mat, bins->medium_rows, bins->n_medium, num_threads, bins->medium_bounds);
+
+    printf("Row bins: short=%d medium=%d long=%d (long threshold: %lld nz)\n",
+           bins->n_short, bins->n_medium, bins->n_long, long_min);
+
+    return bins;
+}
+
+// Prodotto scalare srotolato per righe con al più BIN_SHORT_MAX elementi
+static inline double short_row_dot(const double *val, const int *col, int len, const double *x) {
+    double sum = 0.0;
+    switch (len) {
+        case 8: sum += val[7] * x[col[7]]; /* fall through */
+        case 7: sum += val[6] * x[col[6]]; /* fall through */
+        case 6: sum += val[5] * x[col[5]]; /* fall through */
+        case 5: sum += val[4] * x[col[4]]; /* fall through */
+        case 4: sum += val[3] * x[col[3]]; /* fall through */
+        case 3: sum += val[2] * x[col[2]]; /* fall through */
+        case 2: sum += val[1] * x[col[1]]; /* fall through */
+        case 1: sum += val[0] * x[col[0]]; /* fall through */
+        default: break;
+    }
+    return sum;
+}
+
+void csr_spmv_binned(Matrix *mat, RowBins *bins, double *x, double *y) {
+    double long_sum = 0.0;
+
+    #pragma omp parallel num_threads(bins->num_threads)
+    {
+        int tid = omp_get_thread_num();
+        int nth = omp_get_num_threads();
+
+        // Se il runtime concede meno thread, ognuno prende più intervalli
+        for (int t = tid; t < bins->num_threads; t += nth) {
+            for (int b = bins->short_bounds[t]; b < bins->short_bounds[t + 1]; b++) {
+                int i = bins->short_rows[b];
+                int start = mat->prefixSum[i];
+                y[i] += short_row_dot(&mat->sorted_val[start], &mat->sorted_J[start],
+                                      mat->prefixSum[i + 1] - start, x);
             }
-            break;
-        case 1:  // dynamic
-            #pragma omp parallel for num_threads(num_threads) schedule(dynamic, chunk_size)
-            for(int i = 0; i < mat->M; i++) {
-                for(int k = mat->prefixSum[i]; k < mat->prefixSum[i + 1]; k++) {
-                    y[i] += mat->sorted_val[k] * x[mat->sorted_J[k]];
+
+            for (int b = bins->medium_bounds[t]; b < bins->medium_bounds[t + 1]; b++) {
+                int i = bins->medium_rows[b];
+                double sum = 0.0;
+                #pragma omp simd reduction(+:sum)
+                for (int k = mat->prefixSum[i]; k < mat->prefixSum[i + 1]; k++) {
+                    sum += mat->sorted_val[k] * x[mat->sorted_J[k]];
                 }
+                y[i] += sum;
+            }
+        }
+
+        // Righe lunghe: tutti i thread riducono la stessa riga
+        for (int l = 0; l < bins->n_long; l++) {
+            int i = bins->long_rows[l];
+            #pragma omp for schedule(static) reduction(+:long_sum)
+            for (int k = mat->prefixSum[i]; k < mat->prefixSum[i + 1]; k++) {
+                long_sum += mat->sorted_val[k] * x[mat->sorted_J[k]];
+            }
+            #pragma omp single
+            {
+                y[i] += long_sum;
+                long_sum = 0.0;
+            }
+        }
+    }
+}
+
+void free_row_bins(RowBins *bins) {
+    if (bins) {
+        free(bins->short_rows);
+        free(bins->medium_rows);
+        free(bins->long_rows);
+        free(bins->short_bounds);
+        free(bins->medium_bounds);
+        free(bins);
+    }
+}
+
+SpmvPlan* csr_plan_create(Matrix *mat, int num_threads, int schedule_type, int chunk_size) {
+    SpmvPlan *plan = (SpmvPlan*)malloc(sizeof(SpmvPlan));
+    plan->num_threads = num_threads;
+    plan->schedule_type = schedule_type;
+    plan->chunk_size = chunk_size;
+    plan->barrier_count = 0;
+    plan->barrier_sense = 0;
+    plan->thread_ranges = (int*)malloc((num_threads + 1) * sizeof(int));
+
+    if (schedule_type == 0) {
+        // static: stessi blocchi round-robin di schedule(static, chunk_size),
+        // raggruppati per thread
+        int n_chunks = (mat->M + chunk_size - 1) / chunk_size;
+        plan->n_ranges = n_chunks;
+        plan->range_begin = (int*)malloc((n_chunks + 1) * sizeof(int));
+        plan->range_end = (int*)malloc((n_chunks + 1) * sizeof(int));
+
+        int r = 0;
+        for (int t = 0; t < num_threads; t++) {
+            plan->thread_ranges[t] = r;
+            for (int c = t; c < n_chunks; c += num_threads) {
+                plan->range_begin[r] = c * chunk_size;
+                plan->range_end[r] = (c + 1) * chunk_size < mat->M ? (c + 1) * chunk_size : mat->M;
+                r++;
+            }
+        }
+        plan->thread_ranges[num_threads] = r;
+    } else {
+        // dynamic/guided: il bilanciamento che il runtime farebbe a ogni
+        // chiamata viene calcolato una volta sola, un intervallo contiguo per
+        // thread con circa lo stesso numero di nz
+        plan->n_ranges = num_threads;
+        plan->range_begin = (int*)malloc(num_threads * sizeof(int));
+        plan->range_end = (int*)malloc(num_threads * sizeof(int));
+
+        long long total = (long long)mat->nz + mat->M;
+        int row = 0;
+        for (int t = 0; t < num_threads; t++) {
+            long long target = total * (t + 1) / num_threads;
+            plan->thread_ranges[t] = t;
+            plan->range_begin[t] = row;
+            while (row < mat->M && (long long)mat->prefixSum[row + 1] + row + 1 <= target) {
+                row++;
             }
-            break;
-        case 2:  // guided
-            #pragma omp parallel for num_threads(num_threads) schedule(guided, chunk_size)
-            for(int i = 0; i < mat->M; i++) {
-                for(int k = mat->prefixSum[i]; k < mat->prefixSum[i + 1]; k++) {
-                    y[i] += mat->sorted_val[k] * x[mat->sorted_J[k]];
+            if (t == num_threads - 1) row = mat->M;
+            plan->range_end[t] = row;
+        }
+        plan->thread_ranges[num_threads] = num_threads;
+    }
+
+    return plan;
+}
+
+// Barriera sense-reversing a spin: evita il costo della barriera del runtime
+// quando l'intervallo tra due SpMV è di pochi microsecondi. Dopo
+// PLAN_SPIN_LIMIT tentativi cede la CPU (nodi con più thread che core)
+#define PLAN_SPIN_LIMIT 4096
+
+static void plan_barrier(SpmvPlan *plan, int nth, int *local_sense) {
+    int arrived;
+    *local_sense = !*local_sense;
+
+    #pragma omp flush
+    #pragma omp atomic capture
+    arrived = ++plan->barrier_count;
+
+    if (arrived == nth) {
+        plan->barrier_count = 0;
+        #pragma omp flush
+        #pragma omp atomic write
+        plan->barrier_sense = *local_sense;
+    } else {
+        int current, spins = 0;
+        do {
+            #pragma omp atomic read
+            current = plan->barrier_sense;
+            if (++spins == PLAN_SPIN_LIMIT) {
+                sched_yield();
+                spins = 0;
+            }
+        } while (current != *local_sense);
+    }
+    #pragma omp flush
+}
+
+void csr_plan_execute(SpmvPlan *plan, Matrix *mat, double *x, double *y,
+                      int iterations, double *times) {
+    // Letto prima della regione: il primo thread che chiude la barriera lo modifica
+    int start_sense = plan->barrier_sense;
+
+    #pragma omp parallel num_threads(plan->num_threads)
+    {
+        int tid = omp_get_thread_num();
+        int nth = omp_get_num_threads();
+        int local_sense = start_sense;
+        double t_prev = 0.0, t_now;
+
+        plan_barrier(plan, nth, &local_sense);
+        if (tid == 0) GET_TIME(t_prev);
+
+        for (int iter = 0; iter < iterations; iter++) {
+            for (int t = tid; t < plan->num_threads; t += nth) {
+                for (int r = plan->thread_ranges[t]; r < plan->thread_ranges[t + 1]; r++) {
+                    for (int i = plan->range_begin[r]; i < plan->range_end[r]; i++) {
+                        double sum = 0.0;
+                        for (int k = mat->prefixSum[i]; k < mat->prefixSum[i + 1]; k++) {
+                            sum += mat->sorted_val[k] * x[mat->sorted_J[k]];
+                        }
+                        y[i] = sum;
+                    }
                 }
             }
-            break;
+
+            plan_barrier(plan, nth, &local_sense);
+            if (tid == 0) {
+                GET_TIME(t_now);
+                if (times) times[iter] = t_now - t_prev;
+                t_prev = t_now;
+            }
+        }
+    }
+}
+
+void free_spmv_plan(SpmvPlan *plan) {
+    if (plan) {
+        free(plan->thread_ranges);
+        free(plan->range_begin);
+        free(plan->range_end);
+        free(plan);
+    }
+}
+
+// Lo scatter di A^T x scrive in colonne qualsiasi: i buffer privati costano
+// threads * N in azzeramento e riduzione, gli atomic costano su ogni nz
+int csr_transpose_choose(Matrix *mat, int num_threads) {
+    if ((long long)num_threads * mat->N <= (long long)TRANSPOSE_BUFFER_RATIO * mat->nz) {
+        return TRANSPOSE_BUFFERS;
     }
+    return TRANSPOSE_ATOMIC;
 }
 
+TransposePlan* csr_transpose_create(Matrix *mat, int num_threads, int method) {
+    TransposePlan *tp = (TransposePlan*)calloc(1, sizeof(TransposePlan));
+    if (method == TRANSPOSE_AUTO) method = csr_transpose_choose(mat, num_threads);
+    tp->method = method;
+    tp->num_threads = num_threads;
 
+    if (method == TRANSPOSE_BUFFERS && num_threads > 1) {
+        tp->buffers = (double*)malloc((long long)num_threads * mat->N * sizeof(double));
+    } else if (method == TRANSPOSE_CSC) {
+        // Conteggio per colonna e riempimento stabile: righe crescenti in ogni colonna
+        tp->col_ptr = (int*)calloc(mat->N + 1, sizeof(int));
+        tp->row_ind = (int*)malloc(mat->nz * sizeof(int));
+        tp->csc_val = (double*)malloc(mat->nz * sizeof(double));
 
+        for (int k = 0; k < mat->nz; k++) tp->col_ptr[mat->sorted_J[k] + 1]++;
+        for (int j = 0; j < mat->N; j++) tp->col_ptr[j + 1] += tp->col_ptr[j];
 
+        int *next_pos = (int*)malloc(mat->N * sizeof(int));
+        for (int j = 0; j < mat->N; j++) next_pos[j] = tp->col_ptr[j];
+        for (int i = 0; i < mat->M; i++) {
+            for (int k = mat->prefixSum[i]; k < mat->prefixSum[i + 1]; k++) {
+                int dest = next_pos[mat->sorted_J[k]]++;
+                tp->row_ind[dest] = i;
+                tp->csc_val[dest] = mat->sorted_val[k];
+            }
+        }
+        free(next_pos);
+    }
+
+    return tp;
+}
+
+void csr_spmv_transpose(TransposePlan *tp, Matrix *mat, double *x, double *y) {
+    const int N = mat->N;
+
+    if (tp->method == TRANSPOSE_CSC) {
+        // Con la CSC A^T x è un prodotto per righe: nessun conflitto tra thread
+        #pragma omp parallel for num_threads(tp->num_threads) schedule(static)
+        for (int j = 0; j < N; j++) {
+            double sum = 0.0;
+            for (int k = tp->col_ptr[j]; k < tp->col_ptr[j + 1]; k++) {
+                sum += tp->csc_val[k] * x[tp->row_ind[k]];
+            }
+            y[j] += sum;
+        }
+    } else if (tp->method == TRANSPOSE_ATOMIC) {
+        #pragma omp parallel for num_threads(tp->num_threads) schedule(static)
+        for (int i = 0; i < mat->M; i++) {
+            double xi = x[i];
+            for (int k = mat->prefixSum[i]; k < mat->prefixSum[i + 1]; k++) {
+                #pragma omp atomic
+                y[mat->sorted_J[k]] += mat->sorted_val[k] * xi;
+            }
+        }
+    } else if (!tp->buffers) {
+        // Un solo thread: lo scatter va direttamente in y
+        for (int i = 0; i < mat->M; i++) {
+            double xi = x[i];
+            for (int k = mat->prefixSum[i]; k < mat->prefixSum[i + 1]; k++) {
+                y[mat->sorted_J[k]] += mat->sorted_val[k] * xi;
+            }
+        }
+    } else {
+        #pragma omp parallel num_threads(tp->num_threads)
+        {
+            int tid = omp_get_thread_num();
+            int nth = omp_get_num_threads();
+            double *buf = tp->buffers + (long long)tid * N;
+
+            for (int j = 0; j < N; j++) buf[j] = 0.0;
+
+            #pragma omp for schedule(static)
+            for (int i = 0; i < mat->M; i++) {
+                double xi = x[i];
+                for (int k = mat->prefixSum[i]; k < mat->prefixSum[i + 1]; k++) {
+                    buf[mat->sorted_J[k]] += mat->sorted_val[k] * xi;
+                }
+            }
+
+            // Riduzione per colonne dopo la barriera implicita del ciclo precedente
+            #pragma omp for schedule(static)
+            for (int j = 0; j < N; j++) {
+                double sum = 0.0;
+                for (int t = 0; t < nth; t++) sum += tp->buffers[(long long)t * N + j];
+                y[j] += sum;
+            }
+        }
+    }
+}
+
+const char* transpose_method_name(int method) {
+    switch (method) {
+        case TRANSPOSE_BUFFERS: return "buffers";
+        case TRANSPOSE_ATOMIC:  return "atomic";
+        case TRANSPOSE_CSC:     return "csc";
+        default:                return "auto";
+    }
+}
+
+void free_transpose_plan(TransposePlan *tp) {
+    if (tp) {
+        free(tp->buffers);
+        free(tp->col_ptr);
+        free(tp->row_ind);
+        free(tp->csc_val);
+        free(tp);
+    }
+}
@@ -0,0 +1,129 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <omp.h>
+
+#include "eigen.h"
+#include "csr.h"
+#include "tridiag.h"
+#include "alloc.h"
+
+EigenState* eigen_create(Matrix *mat, int mode, int max_steps,
+                         int num_threads, int schedule_type, int chunk_size) {
+    EigenState *es = (EigenState*)calloc(1, sizeof(EigenState));
+    es->mode = mode;
+    es->n = mat->M;
+    es->num_threads = num_threads;
+    es->schedule_type = schedule_type;
+    es->chunk_size = chunk_size;
+    es->max_steps = max_steps;
+    es->v = (double*)alloc_zeroed(mat->M, sizeof(double));
+    es->w = (double*)alloc_zeroed(mat->M, sizeof(double));
+
+    // Vettore iniziale deterministico, non costante (su grafi regolari il
+    // vettore costante è già un autovettore e Lanczos si fermerebbe subito)
+    double norm2 = 0.0;
+    for (int i = 0; i < mat->M; i++) {
+        es->v[i] = 1.0 + (i % 7) * 0.1;
+        norm2 += es->v[i] * es->v[i];
+    }
+    double inv = 1.0 / sqrt(norm2);
+    for (int i = 0; i < mat->M; i++) es->v[i] *= inv;
+
+    if (mode == EIGEN_LANCZOS) {
+        es->alpha = (double*)malloc(max_steps * sizeof(double));
+        es->beta = (double*)malloc(max_steps * sizeof(double));
+    }
+    return es;
+}
+
+static void power_step(EigenState *es, Matrix *mat) {
+    // y = A v e ||y||^2 nella stessa passata
+    double norm2 = csr_spmv_norm2(mat, es->v, es->w, es->num_threads,
+                                  es->schedule_type, es->chunk_size);
+    double inv = norm2 > 0.0 ? 1.0 / sqrt(norm2) : 0.0;
+    double dot = 0.0;
+
+    // Quoziente di Rayleigh v^T A v e normalizzazione di y in una passata
+    #pragma omp parallel for num_threads(es->num_threads) schedule(static) reduction(+:dot)
+    for (int i = 0; i < es->n; i++) {
+        dot += es->v[i] * es->w[i];
+        es->w[i] *= inv;
+    }
+    es->lambda = dot;
+
+    double *tmp = es->v;
+    es->v = es->w;
+    es->w = tmp;
+}
+
+static void lanczos_step(EigenState *es, Matrix *mat) {
+    if (es->breakdown || es->steps >= es->max_steps) return;
+    int j = es->steps;
+
+    // w = A v - beta_{j-1} v_{j-1}: w contiene già v_{j-1}
+    csr_spmv_axpby(mat, 1.0, es->v, -es->beta_prev, es->w, es->num_threads,
+                   es->schedule_type, es->chunk_size);
+
+    double alpha = 0.0;
+    #pragma omp parallel for num_threads(es->num_threads) schedule(static) reduction(+:alpha)
+    for (int i = 0; i < es->n; i++) alpha += es->w[i] * es->v[i];
+
+    double norm2 = 0.0;
+    #pragma omp parallel for num_threads(es->num_threads) schedule(static) reduction(+:norm2)
+    for (int i = 0; i < es->n; i++) {
+        es->w[i] -= alpha * es->v[i];
+        norm2 += es->w[i] * es->w[i];
+    }
+    double beta = sqrt(norm2);
+
+    es->alpha[j] = alpha;
+    es->beta[j] = beta;
+    es->steps++;
+    if (beta < 1e-12 * fabs(alpha) || beta == 0.0) {
+        es->breakdown = 1;
+        return;
+    }
+
+    // v_{j+1} = w / beta; il buffer di v diventa v_{j-1} del passo successivo
+    double inv = 1.0 / beta;
+    #pragma omp parallel for num_threads(es->num_threads) schedule(static)
+    for (int i = 0; i < es->n; i++) es->w[i] *= inv;
+
+    double *tmp = es->v;
+    es->v = es->w;
+    es->w = tmp;
+    es->beta_prev = beta;
+}
+
+void eigen_step(EigenState *es, Matrix *mat) {
+    if (es->mode == EIGEN_POWER) {
+        power_step(es, mat);
+        es->steps++;
+    } else {
+        lanczos_step(es, mat);
+    }
+}
+
+void eigen_estimate(EigenState *es, double *lambda_min, double *lambda_max) {
+    if (es->mode == EIGEN_POWER) {
+        *lambda_min = *lambda_max = es->lambda;
+    } else {
+        tridiag_extreme_eigenvalues(es->alpha, es->beta, es->steps, lambda_min, lambda_max);
+    }
+}
+
+const char* eigen_mode_name(int mode) {
+    return mode == EIGEN_POWER ? "power" : mode == EIGEN_LANCZOS ? "lanczos" : "none";
+}
+
+void free_eigen_state(EigenState *es) {
+    if (es) {
+        free(es->v);
+        free(es->w);
+        free(es->alpha);
+        free(es->beta);
+        free(es);
+    }
+}
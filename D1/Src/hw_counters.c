@@ -0,0 +1,248 @@
+
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <omp.h>
+
+#include "hw_counters.h"
+#include "my_timer.h"
+
+#define STREAM_MIN_ELEMS (1L << 22)
+#define STREAM_MAX_ELEMS (1L << 26)
+#define STREAM_NTIMES    5
+
+static const char *event_names[HWC_NUM_EVENTS] = {
+    "cycles", "instructions", "L1D read misses", "LLC read misses", "LLC write misses"
+};
+
+static void event_attr(int event, struct perf_event_attr *attr) {
+    memset(attr, 0, sizeof(*attr));
+    attr->size = sizeof(*attr);
+    attr->disabled = (event == HWC_CYCLES);   // il leader abilita tutto il gruppo
+    attr->exclude_kernel = 1;
+    attr->exclude_hv = 1;
+    attr->read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                        PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    switch (event) {
+        case HWC_CYCLES:
+            attr->type = PERF_TYPE_HARDWARE;
+            attr->config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case HWC_INSTRUCTIONS:
+            attr->type = PERF_TYPE_HARDWARE;
+            attr->config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case HWC_L1D_MISSES:
+            attr->type = PERF_TYPE_HW_CACHE;
+            attr->config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                           (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+        case HWC_LLC_MISSES:
+            attr->type = PERF_TYPE_HW_CACHE;
+            attr->config = PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                           (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+        case HWC_LLC_WMISSES:
+            attr->type = PERF_TYPE_HW_CACHE;
+            attr->config = PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_WRITE << 8) |
+                           (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+    }
+}
+
+static int perf_open(struct perf_event_attr *attr, int group_fd) {
+    return (int)syscall(__NR_perf_event_open, attr, 0, -1, group_fd, 0);
+}
+
+HwCounters* hwc_open(int num_threads) {
+    HwCounters *hwc = (HwCounters*)calloc(1, sizeof(HwCounters));
+    hwc->num_threads = num_threads;
+    hwc->fds = (int*)malloc(num_threads * HWC_NUM_EVENTS * sizeof(int));
+    hwc->slot = (int*)malloc(num_threads * HWC_NUM_EVENTS * sizeof(int));
+    for (int i = 0; i < num_threads * HWC_NUM_EVENTS; i++) {
+        hwc->fds[i] = -1;
+        hwc->slot[i] = -1;
+    }
+
+    // Ogni thread della squadra apre i contatori per se stesso: i thread di
+    // OpenMP vengono riusati dalle regioni parallele successive con lo stesso
+    // numero di thread, quindi i kernel cronometrati restano coperti
+    #pragma omp parallel num_threads(num_threads)
+    {
+        int t = omp_get_thread_num();
+        int *fds = &hwc->fds[t * HWC_NUM_EVENTS];
+        int *slot = &hwc->slot[t * HWC_NUM_EVENTS];
+        struct perf_event_attr attr;
+        int n_open = 0;
+
+        event_attr(HWC_CYCLES, &attr);
+        fds[HWC_CYCLES] = perf_open(&attr, -1);
+        if (fds[HWC_CYCLES] >= 0) {
+            slot[HWC_CYCLES] = n_open++;
+            for (int e = 1; e < HWC_NUM_EVENTS; e++) {
+                event_attr(e, &attr);
+                fds[e] = perf_open(&attr, fds[HWC_CYCLES]);
+                if (fds[e] >= 0) slot[e] = n_open++;
+            }
+        }
+    }
+
+    for (int e = 0; e < HWC_NUM_EVENTS; e++) {
+        hwc->event_ok[e] = 1;
+        for (int t = 0; t < num_threads; t++) {
+            if (hwc->fds[t * HWC_NUM_EVENTS + e] < 0) hwc->event_ok[e] = 0;
+        }
+    }
+    hwc->available = hwc->event_ok[HWC_CYCLES];
+
+    if (!hwc->available) {
+        fprintf(stderr, "Warning: perf_event_open not available (check /proc/sys/kernel/perf_event_paranoid), "
+                        "hardware counters disabled\n");
+    }
+    return hwc;
+}
+
+static void group_ioctl(HwCounters *hwc, unsigned long request) {
+    for (int t = 0; t < hwc->num_threads; t++) {
+        int leader = hwc->fds[t * HWC_NUM_EVENTS + HWC_CYCLES];
+        if (leader >= 0) ioctl(leader, request, PERF_IOC_FLAG_GROUP);
+    }
+}
+
+void hwc_start(HwCounters *hwc) {
+    if (hwc && hwc->available) group_ioctl(hwc, PERF_EVENT_IOC_ENABLE);
+}
+
+void hwc_stop(HwCounters *hwc) {
+    if (hwc && hwc->available) group_ioctl(hwc, PERF_EVENT_IOC_DISABLE);
+}
+
+void hwc_read(HwCounters *hwc) {
+    memset(hwc->values, 0, sizeof(hwc->values));
+    if (!hwc->available) return;
+
+    // Formato: nr, time_enabled, time_running, valori[nr]
+    unsigned long long buf[3 + HWC_NUM_EVENTS];
+    for (int t = 0; t < hwc->num_threads; t++) {
+        int *fds = &hwc->fds[t * HWC_NUM_EVENTS];
+        int *slot = &hwc->slot[t * HWC_NUM_EVENTS];
+        if (read(fds[HWC_CYCLES], buf, sizeof(buf)) <= 0) continue;
+
+        double scale = (buf[2] > 0) ? (double)buf[1] / (double)buf[2] : 1.0;
+        for (int e = 0; e < HWC_NUM_EVENTS; e++) {
+            if (slot[e] >= 0 && (unsigned long long)slot[e] < buf[0]) {
+                hwc->values[e] += (long long)(buf[3 + slot[e]] * scale);
+            }
+        }
+    }
+}
+
+void hwc_close(HwCounters *hwc) {
+    if (hwc) {
+        for (int i = 0; i < hwc->num_threads * HWC_NUM_EVENTS; i++) {
+            if (hwc->fds[i] >= 0) close(hwc->fds[i]);
+        }
+        free(hwc->fds);
+        free(hwc->slot);
+        free(hwc);
+    }
+}
+
+double spmv_bytes_moved(Matrix *mat) {
+    return (double)mat->nz * (sizeof(double) + sizeof(int))   // sorted_val, sorted_J
+         + (double)(mat->M + 1) * sizeof(int)                  // prefixSum
+         + (double)mat->N * sizeof(double)                     // x, almeno una volta
+         + 2.0 * mat->M * sizeof(double);                      // y letto e scritto
+}
+
+double hwc_stream_bandwidth(int num_threads) {
+    // Array di almeno 4 volte la LLC, come richiesto dalle regole di STREAM
+    long n = STREAM_MIN_ELEMS;
+    long llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    if (llc > 0 && 4 * llc / (long)sizeof(double) > n) n = 4 * llc / (long)sizeof(double);
+    if (n > STREAM_MAX_ELEMS) n = STREAM_MAX_ELEMS;
+
+    double *a = (double*)malloc(n * sizeof(double));
+    double *b = (double*)malloc(n * sizeof(double));
+    double *c = (double*)malloc(n * sizeof(double));
+    if (!a || !b || !c) {
+        free(a); free(b); free(c);
+        return 0.0;
+    }
+
+    // Inizializzazione parallela: le pagine finiscono sui nodi NUMA dei thread
+    #pragma omp parallel for num_threads(num_threads) schedule(static)
+    for (long i = 0; i < n; i++) {
+        a[i] = 0.0;
+        b[i] = 1.0;
+        c[i] = 2.0;
+    }
+
+    double best = 0.0;
+    for (int k = 0; k < STREAM_NTIMES; k++) {
+        double start, stop;
+        GET_TIME(start);
+        #pragma omp parallel for num_threads(num_threads) schedule(static)
+        for (long i = 0; i < n; i++) {
+            a[i] = b[i] + 3.0 * c[i];
+        }
+        GET_TIME(stop);
+        double bw = 3.0 * sizeof(double) * n / (stop - start) / 1e9;
+        if (bw > best) best = bw;
+    }
+
+    if (a[n / 2] != 7.0) fprintf(stderr, "Warning: STREAM triad check failed\n");
+    free(a); free(b); free(c);
+    return best;
+}
+
+void hwc_print_roofline(HwCounters *hwc, Matrix *mat, int iterations,
+                        double total_time, double stream_bw) {
+    double t = total_time / iterations;
+    double bytes = spmv_bytes_moved(mat);
+    double flops = 2.0 * mat->nz;
+    double ai = flops / bytes;
+
+    printf("\n=== HW COUNTERS (timed SpMV only, %d iterations, per SpMV) ===\n", iterations);
+    if (hwc && hwc->available) {
+        for (int e = 0; e < HWC_NUM_EVENTS; e++) {
+            if (hwc->event_ok[e]) printf("%s: %.0f\n", event_names[e], (double)hwc->values[e] / iterations);
+            else printf("%s: n/a\n", event_names[e]);
+        }
+        if (hwc->values[HWC_CYCLES] > 0) {
+            printf("IPC: %.3f\n", (double)hwc->values[HWC_INSTRUCTIONS] / hwc->values[HWC_CYCLES]);
+        }
+        if (hwc->event_ok[HWC_L1D_MISSES]) {
+            printf("L1D misses per nz: %.4f\n", (double)hwc->values[HWC_L1D_MISSES] / iterations / mat->nz);
+        }
+    } else {
+        printf("hardware counters not available\n");
+    }
+
+    printf("\n=== ROOFLINE ===\n");
+    printf("Time per SpMV: %.9f s\n", t);
+    printf("Bytes per SpMV (model): %.0f\n", bytes);
+    printf("Arithmetic intensity: %.4f flop/byte\n", ai);
+    printf("Achieved: %.4f GFLOPS, %.4f GB/s (model)\n", flops / t / 1e9, bytes / t / 1e9);
+    if (hwc && hwc->available && hwc->event_ok[HWC_LLC_MISSES]) {
+        double dram = (double)(hwc->values[HWC_LLC_MISSES] +
+                               (hwc->event_ok[HWC_LLC_WMISSES] ? hwc->values[HWC_LLC_WMISSES] : 0))
+                      * HWC_CACHE_LINE / iterations;
+        printf("Measured DRAM traffic (LLC misses x %d B): %.0f bytes, %.4f GB/s\n",
+               HWC_CACHE_LINE, dram, dram / t / 1e9);
+    }
+    if (stream_bw > 0.0) {
+        double bound = ai * stream_bw;
+        printf("STREAM triad bandwidth: %.4f GB/s\n", stream_bw);
+        printf("Roofline bound: %.4f GFLOPS (attained %.1f%%, bandwidth utilisation %.1f%%)\n",
+               bound, 100.0 * flops / t / 1e9 / bound, 100.0 * bytes / t / 1e9 / stream_bw);
+    }
+}
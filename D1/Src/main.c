@@ -4,28 +4,154 @@
 #include <omp.h>
 #include "matrix_io.h"
 #include "csr.h"
+#include "tuner.h"
+#include "tiled_csr.h"
+#include "dia.h"
+#include "ooc.h"
+#include "eigen.h"
+#include "alloc.h"
+#include "hw_counters.h"
+#include "bench.h"
 #include "my_timer.h"
 
-#define ITER_NEVER_PERF 10
 #define ITER_PERF 1
 
-int compare_doubles(const void *a, const void *b) {
-    double diff = (*(double*)a - *(double*)b);
-    if (diff > 0) return 1;
-    if (diff < 0) return -1;
-    return 0;
+// --fused=axpby: y = FUSED_ALPHA A x + FUSED_BETA y (y resta limitato tra le iterazioni)
+#define FUSED_ALPHA 1.0
+#define FUSED_BETA  0.5
+
+// Una SpMV cronometrata con il kernel selezionato; y viene azzerato fuori
+// dalla misura. I contatori hardware, se presenti, coprono solo il kernel
+static double timed_spmv(Matrix *mat, double *x, double *y, int is_sequential, RowBins *bins,
+                         TiledCSR *tiled, DiaMatrix *dia, TransposePlan *tplan, int fused,
+                         double *scalar, int num_threads, int schedule, int chunk_size,
+                         HwCounters *hwc) {
+    double start, stop;
+    int nt = is_sequential ? 1 : num_threads;
+
+    // I kernel fusi scrivono y senza leggerlo (o lo leggono per beta y):
+    // nessun passaggio di azzeramento
+    if (!fused) memset(y, 0, (tplan ? mat->N : mat->M) * sizeof(double));
+
+    hwc_start(hwc);
+    if (fused == FUSED_AXPBY) {
+        GET_TIME(start);
+        csr_spmv_axpby(mat, FUSED_ALPHA, x, FUSED_BETA, y, nt, schedule, chunk_size);
+        GET_TIME(stop);
+    } else if (fused == FUSED_XDOT) {
+        GET_TIME(start);
+        *scalar = csr_spmv_xdot(mat, x, y, nt, schedule, chunk_size);
+        GET_TIME(stop);
+    } else if (fused == FUSED_NORM2) {
+        GET_TIME(start);
+        *scalar = csr_spmv_norm2(mat, x, y, nt, schedule, chunk_size);
+        GET_TIME(stop);
+    } else if (tplan) {
+        GET_TIME(start);
+        csr_spmv_transpose(tplan, mat, x, y);
+        GET_TIME(stop);
+    } else if (is_sequential) {
+        GET_TIME(start);
+        csr_spmv_seq(mat, x, y);
+        GET_TIME(stop);
+    } else if (bins) {
+        GET_TIME(start);
+        csr_spmv_binned(mat, bins, x, y);
+        GET_TIME(stop);
+    } else if (tiled) {
+        GET_TIME(start);
+        csr_spmv_tiled(tiled, x, y, num_threads, chunk_size);
+        GET_TIME(stop);
+    } else if (dia) {
+        GET_TIME(start);
+        dia_spmv(dia, x, y, num_threads);
+        GET_TIME(stop);
+    } else {
+        GET_TIME(start);
+        csr_spmv_parallel_schedule(mat, x, y, num_threads, schedule, chunk_size);
+        GET_TIME(stop);
+    }
+    hwc_stop(hwc);
+
+    return stop - start;
 }
 
-double calculate_90th_percentile(double *times, int n) {
-    if (n == 1) return times[0];
-    qsort(times, n, sizeof(double), compare_doubles);
-    double k = 0.90 * n;
-    int index = (int)k;
-    if (k == (double)index && index > 0)
-        return (times[index-1] + times[index]) / 2.0;
-    if (k != (double)index)
-        index = (int)(k + 1);
-    return times[index];
+// Modalità out-of-core: la matrice non viene mai caricata tutta in memoria.
+// Il file a blocchi viene creato dal .mtx alla prima esecuzione e riusato
+// dalle successive finché matrice e blocco coincidono; ogni SpMV rilegge i
+// blocchi dal disco
+static int run_out_of_core(const char *matrix_file, const char *ooc_file, long block_bytes,
+                           int num_threads, int schedule, int chunk_size, const char *config,
+                           BenchConfig *bench) {
+    OocHeader src;
+    if (!ooc_source_info(matrix_file, block_bytes, &src)) return 1;
+
+    OocMatrix *om = ooc_open(ooc_file);
+    if (om && !ooc_matches(om, &src)) {
+        printf("Out-of-core: %s was built from another matrix or block size, rebuilding\n", ooc_file);
+        ooc_close(om);
+        om = NULL;
+    }
+    if (!om) {
+        if (ooc_convert_mtx(matrix_file, ooc_file, block_bytes) != 0) return 1;
+        om = ooc_open(ooc_file);
+        if (!om) return 1;
+    }
+
+    int vec_len = om->hdr.M > om->hdr.N ? (int)om->hdr.M : (int)om->hdr.N;
+    double *x = (double*)alloc_zeroed(vec_len, sizeof(double));
+    double *y = (double*)alloc_zeroed(vec_len, sizeof(double));
+    for (int i = 0; i < vec_len; i++) x[i] = 1.0;
+
+    double start, stop, pilot = 0.0, dummy = 0.0;
+    int n_pilot = bench->warmup > 0 ? bench->warmup : (bench->target_time > 0.0 ? 1 : 0);
+    for (int w = 0; w < n_pilot; w++) {
+        GET_TIME(start);
+        ooc_spmv(om, x, y, num_threads, schedule, chunk_size);
+        GET_TIME(stop);
+        pilot = stop - start;
+    }
+
+    int iterations = bench_iterations_for(bench, pilot);
+    double *times = (double*)malloc(iterations * sizeof(double));
+    double read_time = 0.0, wait_time = 0.0, bytes_read = 0.0;
+
+    for (int iter = 0; iter < iterations; iter++) {
+        if (bench->flush_cache) bench_flush_cache();
+        GET_TIME(start);
+        ooc_spmv(om, x, y, num_threads, schedule, chunk_size);
+        GET_TIME(stop);
+        times[iter] = stop - start;
+        read_time += om->read_time;
+        wait_time += om->wait_time;
+        bytes_read += om->bytes_read;
+        for (int i = 0; i < om->hdr.M; i++) dummy += y[i];
+    }
+
+    double total_time = 0.0;
+    for (int iter = 0; iter < iterations; iter++) total_time += times[iter];
+
+    BenchStats stats;
+    bench_compute_stats(times, iterations, &stats);
+    double vec_bytes = (double)(om->hdr.N + om->hdr.M) * sizeof(double);
+    bench_write_results(bench, matrix_file, config, &stats, 2.0 * om->hdr.nnz,
+                        bytes_read / iterations + vec_bytes);
+
+    printf("%.6f\n", stats.p90);
+    bench_print_stats(config, &stats);
+    fprintf(stderr, "[OOC] read %.2f GB/s (%.1f MB per SpMV) compute waited %.1f%% of the time for data\n",
+            read_time > 0.0 ? bytes_read / read_time / 1e9 : 0.0, bytes_read / iterations / 1e6,
+            total_time > 0.0 ? 100.0 * wait_time / total_time : 0.0);
+    fprintf(stderr, "[DEBUG] Iter: %d (warm-up %d), 90th percentile time: %.6f sec (%.4f ms), Dummy: %.6e\n",
+            iterations, n_pilot, stats.p90, stats.p90 * 1000, dummy);
+    fprintf(stderr, "[MEM] Peak RSS: %.1f MB (block buffers %.1f MB) alloc %s\n", peak_rss_mb(),
+            2.0 * om->max_block_bytes / 1e6, alloc_policy_string());
+
+    free(times);
+    free(x);
+    free(y);
+    ooc_close(om);
+    return 0;
 }
 
 int main(int argc, char *argv[]) {
@@ -33,6 +159,18 @@ int main(int argc, char *argv[]) {
         fprintf(stderr, "Usage: %s <matrix.mtx> <num_threads> <schedule> <chunk_size>\n", argv[0]);
         fprintf(stderr, "  For sequential: %s <matrix.mtx> 1 none none\n", argv[0]);
         fprintf(stderr, "  For parallel: %s <matrix.mtx> <threads> <static|dynamic|guided> <chunk>\n", argv[0]);
+        fprintf(stderr, "  For row-length bins: %s <matrix.mtx> <threads> binned <chunk (ignored)>\n", argv[0]);
+        fprintf(stderr, "  For column panels: %s <matrix.mtx> <threads> tiled <chunk>\n", argv[0]);
+        fprintf(stderr, "  For banded matrices: %s <matrix.mtx> <threads> dia <chunk>\n", argv[0]);
+        fprintf(stderr, "  For autotuning: %s <matrix.mtx> <max_threads> auto <chunk (ignored)>\n", argv[0]);
+        fprintf(stderr, "  Options: --plan      (static|dynamic|guided: preplanned rows, one persistent parallel region)\n");
+        fprintf(stderr, "           --counters  (perf_event_open counters around the timed SpMV + roofline report)\n");
+        fprintf(stderr, "           --transpose[=auto|buffers|atomic|csc]  (time y = A^T x instead of y = A x)\n");
+        fprintf(stderr, "           --fused=axpby|xdot|norm2  (y = aAx + by / x^T A x / ||Ax||^2 in the same sweep)\n");
+        fprintf(stderr, "           --eigen=power|lanczos  (chained SpMV: x <- Ax/||Ax||, report extreme eigenvalues)\n");
+        fprintf(stderr, "           --ooc=<file> [--ooc-block=<MB>]  (stream the matrix from a row-block file, created from the .mtx if missing)\n");
+        fprintf(stderr, "%s", bench_options_help());
+        fprintf(stderr, "%s", alloc_options_help());
         return 1;
     }
 
@@ -50,6 +188,10 @@ int main(int argc, char *argv[]) {
         if (strcmp(schedule_str, "static") == 0) schedule = 0;
         else if (strcmp(schedule_str, "dynamic") == 0) schedule = 1;
         else if (strcmp(schedule_str, "guided") == 0) schedule = 2;
+        else if (strcmp(schedule_str, "binned") == 0) schedule = 3;
+        else if (strcmp(schedule_str, "auto") == 0) schedule = 4;
+        else if (strcmp(schedule_str, "tiled") == 0) schedule = 5;
+        else if (strcmp(schedule_str, "dia") == 0) schedule = 6;
         else {
             fprintf(stderr, "Error: invalid schedule '%s'\n", schedule_str);
             return 1;
@@ -62,62 +204,311 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    int use_plan = 0;
+    int use_counters = 0;
+    int transpose = -1;
+    int fused = FUSED_NONE;
+    int eigen = EIGEN_NONE;
+    const char *ooc_file = NULL;
+    long ooc_block_mb = OOC_DEFAULT_BLOCK_MB;
+    BenchConfig bench;
+    bench_default_config(&bench);
+    for (int a = 5; a < argc; a++) {
+        int res = bench_parse_option(&bench, argv[a]);
+        if (res == 0) res = alloc_parse_option(argv[a]);
+        if (res == 1) continue;
+        if (res < 0) {
+            fprintf(stderr, "Error: invalid value in '%s'\n", argv[a]);
+            return 1;
+        }
+        if (strcmp(argv[a], "--plan") == 0) use_plan = 1;
+        else if (strcmp(argv[a], "--counters") == 0) use_counters = 1;
+        else if (strcmp(argv[a], "--transpose") == 0 || strcmp(argv[a], "--transpose=auto") == 0) transpose = TRANSPOSE_AUTO;
+        else if (strcmp(argv[a], "--transpose=buffers") == 0) transpose = TRANSPOSE_BUFFERS;
+        else if (strcmp(argv[a], "--transpose=atomic") == 0) transpose = TRANSPOSE_ATOMIC;
+        else if (strcmp(argv[a], "--transpose=csc") == 0) transpose = TRANSPOSE_CSC;
+        else if (strcmp(argv[a], "--fused=axpby") == 0) fused = FUSED_AXPBY;
+        else if (strcmp(argv[a], "--fused=xdot") == 0) fused = FUSED_XDOT;
+        else if (strcmp(argv[a], "--fused=norm2") == 0) fused = FUSED_NORM2;
+        else if (strcmp(argv[a], "--eigen=power") == 0) eigen = EIGEN_POWER;
+        else if (strcmp(argv[a], "--eigen=lanczos") == 0) eigen = EIGEN_LANCZOS;
+        else if (strncmp(argv[a], "--ooc=", 6) == 0 && argv[a][6] != '\0') ooc_file = argv[a] + 6;
+        else if (strncmp(argv[a], "--ooc-block=", 12) == 0 && atol(argv[a] + 12) > 0) ooc_block_mb = atol(argv[a] + 12);
+        else {
+            fprintf(stderr, "Error: unknown option '%s'\n", argv[a]);
+            return 1;
+        }
+    }
+
+    if (use_plan && (is_sequential || schedule == 3 || schedule >= 5)) {
+        fprintf(stderr, "Error: --plan requires static, dynamic or guided schedule\n");
+        return 1;
+    }
+
+    if (transpose >= 0 && (use_plan || (!is_sequential && schedule >= 3))) {
+        fprintf(stderr, "Error: --transpose requires none, static, dynamic or guided schedule (without --plan)\n");
+        return 1;
+    }
+
+    if (fused && (use_plan || transpose >= 0 || (!is_sequential && schedule >= 3))) {
+        fprintf(stderr, "Error: --fused requires none, static, dynamic or guided schedule (without --plan or --transpose)\n");
+        return 1;
+    }
+
+    if (eigen && (use_plan || transpose >= 0 || fused || (!is_sequential && schedule >= 3))) {
+        fprintf(stderr, "Error: --eigen requires none, static, dynamic or guided schedule without other kernel options\n");
+        return 1;
+    }
+
+    if (use_plan && bench.flush_cache) {
+        fprintf(stderr, "Error: --cold is not supported with --plan (iterations share one parallel region)\n");
+        return 1;
+    }
+
     if(num_threads <= 0) {
         fprintf(stderr, "Error: num_threads must be > 0\n");
         return 1;
     }
 
+    if (ooc_file) {
+        if (use_plan || use_counters || transpose >= 0 || fused || eigen || (!is_sequential && schedule >= 3)) {
+            fprintf(stderr, "Error: --ooc requires none, static, dynamic or guided schedule without other kernel options\n");
+            return 1;
+        }
+        char config[160];
+        snprintf(config, sizeof(config), "%s/%s/%d/%d/ooc", is_sequential ? "sequential" : "parallel",
+                 is_sequential ? "none" : schedule_str, is_sequential ? 0 : chunk_size,
+                 is_sequential ? 1 : num_threads);
+        return run_out_of_core(matrix_file, ooc_file, ooc_block_mb << 20, is_sequential ? 1 : num_threads,
+                               schedule, chunk_size, config, &bench);
+    }
+
     Matrix *mat = read_matrix(matrix_file);
     coo_to_csr(mat);
 
-    double *x = (double*)calloc(mat->M, sizeof(double));
-    double *y = (double*)calloc(mat->M, sizeof(double));
+    if (eigen && mat->M != mat->N) {
+        fprintf(stderr, "Error: --eigen requires a square matrix (got %d x %d)\n", mat->M, mat->N);
+        free_matrix(mat);
+        return 1;
+    }
+    // x^T A x ha senso solo se y e x hanno la stessa lunghezza
+    if (fused == FUSED_XDOT && mat->M != mat->N) {
+        fprintf(stderr, "Error: --fused=xdot requires a square matrix (got %d x %d)\n", mat->M, mat->N);
+        free_matrix(mat);
+        return 1;
+    }
+    if (eigen == EIGEN_LANCZOS && !mat->is_symmetric) {
+        fprintf(stderr, "[EIGEN] warning: matrix is not marked symmetric, Lanczos estimates assume A = A^T\n");
+    }
 
-    for(int i = 0; i < mat->M; i++) {
+    // auto: la configurazione viene dalla cache <matrix>.tune o da una
+    // ricerca breve, poi si prosegue come se fosse stata data a riga di comando
+    if (!is_sequential && schedule == 4) {
+        TuneConfig cfg;
+        int cached = autotune(mat, matrix_file, num_threads, &cfg);
+        num_threads = cfg.num_threads;
+        chunk_size = cfg.chunk_size;
+        schedule = (cfg.kernel == TUNE_KERNEL_BINNED) ? 3 :
+                   (cfg.kernel == TUNE_KERNEL_TILED) ? 5 :
+                   (cfg.kernel == TUNE_KERNEL_DIA) ? 6 : cfg.schedule;
+        // Il piano non svuota la cache tra le iterazioni: con --cold si usa
+        // lo stesso schedule CSR senza piano (il candidato plan ne deriva)
+        if (cfg.kernel == TUNE_KERNEL_PLAN && bench.flush_cache) {
+            cfg.kernel = TUNE_KERNEL_CSR;
+            printf("Autotune: plan kernel not usable with --cold, falling back to CSR\n");
+        }
+        use_plan = use_plan || (cfg.kernel == TUNE_KERNEL_PLAN);
+        printf("Autotune: kernel=%s schedule=%d chunk=%d threads=%d%s\n",
+               tune_kernel_name(cfg.kernel), cfg.schedule, chunk_size, num_threads,
+               cached ? " (cached)" : "");
+    }
+
+    // A^T x legge M elementi di x e scrive N elementi di y
+    int vec_len = mat->M > mat->N ? mat->M : mat->N;
+    double *x = (double*)alloc_zeroed(vec_len, sizeof(double));
+    double *y = (double*)alloc_zeroed(vec_len, sizeof(double));
+
+    for(int i = 0; i < vec_len; i++) {
         x[i] = 1.0;
     }
 
-    int iterations = 0;
+    // L'analisi delle righe si fa una volta sola, fuori dalla regione cronometrata
+    RowBins *bins = NULL;
+    if (!is_sequential && schedule == 3) {
+        bins = csr_build_row_bins(mat, num_threads);
+    }
+
+    // Pannelli di colonne dimensionati sulla cache rilevata
+    TiledCSR *tiled = NULL;
+    if (!is_sequential && schedule == 5) {
+        tiled = csr_build_tiled(mat, detect_cache_size());
+    }
+
+    // DIA solo se la matrice ha poche diagonali dominanti, altrimenti CSR statico
+    DiaMatrix *dia = NULL;
+    if (!is_sequential && schedule == 6) {
+        dia = dia_build(mat->M, mat->N, mat->prefixSum, mat->sorted_J, mat->sorted_val);
+        if (dia) {
+            printf("DIA: %d diagonals, coverage %.3f, fill %.3f, %d leftover nonzeros in CSR\n",
+                   dia->n_diags, dia->coverage, dia->fill, dia->rest_nz);
+        } else {
+            printf("DIA: no dominant diagonals, falling back to static CSR\n");
+            schedule = 0;
+            schedule_str = "static";
+        }
+    }
+
+    // Buffer privati o CSC preparati una volta sola per tutte le iterazioni
+    TransposePlan *tplan = NULL;
+    if (transpose >= 0) {
+        tplan = csr_transpose_create(mat, is_sequential ? 1 : num_threads, transpose);
+        printf("Transpose: method %s%s\n", transpose_method_name(tplan->method),
+               transpose == TRANSPOSE_AUTO ? " (auto)" : "");
+    }
+
+    // Il piano si costruisce una volta per matrice, thread e schedule
+    SpmvPlan *plan = NULL;
+    if (use_plan) {
+        plan = csr_plan_create(mat, num_threads, schedule, chunk_size);
+    }
+
+    // I contatori vengono aperti dai thread della squadra che eseguirà il kernel
+    HwCounters *hwc = NULL;
+    if (use_counters) {
+        hwc = hwc_open(is_sequential ? 1 : num_threads);
+    }
+
+    double dummy = 0.0;
+    double scalar = 0.0;    // x^T A x o ||y||^2 dei kernel fusi
+
 #ifdef PERF_MODE
-    iterations = ITER_PERF;
-#else
-    iterations = ITER_NEVER_PERF;
+    // perf stat esterno: una sola iterazione, senza riscaldamento
+    bench.target_time = 0.0;
+    bench.warmup = 0;
+    bench.min_iters = ITER_PERF;
 #endif
 
+    // Riscaldamento: le iterazioni non vengono misurate; l'ultima fa da
+    // pilota per calibrare il numero di iterazioni sul tempo obiettivo
+    double pilot = 0.0;
+    int n_pilot = bench.warmup > 0 ? bench.warmup : (bench.target_time > 0.0 ? 1 : 0);
+    if (plan) {
+        double *pilot_times = (double*)malloc((n_pilot + 1) * sizeof(double));
+        if (n_pilot > 0) {
+            csr_plan_execute(plan, mat, x, y, n_pilot, pilot_times);
+            pilot = pilot_times[n_pilot - 1];
+        }
+        free(pilot_times);
+    } else {
+        for (int w = 0; w < n_pilot; w++) {
+            if (bench.flush_cache) bench_flush_cache();
+            pilot = timed_spmv(mat, x, y, is_sequential, bins, tiled, dia, tplan, fused, &scalar, num_threads, schedule, chunk_size, NULL);
+        }
+    }
+
+    int iterations = bench_iterations_for(&bench, pilot);
     double *times = (double*)malloc(iterations * sizeof(double));
-    double dummy = 0.0;
 
-    for(int iter = 0; iter < iterations; iter++) {
-        memset(y, 0, mat->M * sizeof(double));
-        double start, stop;
+    // Catena di SpMV: x e y si alternano, una iterazione misurata per passo
+    EigenState *es = NULL;
+    if (eigen) {
+        es = eigen_create(mat, eigen, iterations, is_sequential ? 1 : num_threads, schedule, chunk_size);
+    }
 
-        if (is_sequential) {
-            GET_TIME(start);
-            csr_spmv_seq(mat, x, y);
-            GET_TIME(stop);
-        } else {
-            GET_TIME(start);
-            csr_spmv_parallel_schedule(mat, x, y, num_threads, schedule, chunk_size);
-            GET_TIME(stop);
+    if (plan) {
+        // Tutte le iterazioni nella stessa regione parallela; y = A x non
+        // richiede l'azzeramento di y tra una chiamata e l'altra
+        hwc_start(hwc);
+        csr_plan_execute(plan, mat, x, y, iterations, times);
+        hwc_stop(hwc);
+        for(int i = 0; i < mat->M; i++) {
+            dummy += y[i];
         }
+    }
+
+    int y_len = tplan ? mat->N : mat->M;
+    for(int iter = 0; iter < iterations && es; iter++) {
+        if (bench.flush_cache) bench_flush_cache();
+        double start, stop;
+        hwc_start(hwc);
+        GET_TIME(start);
+        eigen_step(es, mat);
+        GET_TIME(stop);
+        hwc_stop(hwc);
         times[iter] = stop - start;
+        dummy += es->v[0];
 
-        for(int i = 0; i < mat->M; i++) {
+        // Lanczos si ferma su un sottospazio invariante: le statistiche
+        // coprono solo i passi eseguiti
+        if (es->breakdown) {
+            iterations = iter + 1;
+            break;
+        }
+    }
+
+    for(int iter = 0; iter < iterations && !plan && !es; iter++) {
+        if (bench.flush_cache) bench_flush_cache();
+        times[iter] = timed_spmv(mat, x, y, is_sequential, bins, tiled, dia, tplan, fused, &scalar, num_threads, schedule, chunk_size, hwc);
+
+        for(int i = 0; i < y_len; i++) {
             dummy += y[i];
         }
+        dummy += scalar;
+    }
+
+    if (hwc) {
+        double total_time = 0.0;
+        for (int iter = 0; iter < iterations; iter++) total_time += times[iter];
+        hwc_read(hwc);
+        // STREAM dopo il ciclo cronometrato, per non alterare lo stato delle cache
+        double stream_bw = hwc_stream_bandwidth(is_sequential ? 1 : num_threads);
+        hwc_print_roofline(hwc, mat, iterations, total_time, stream_bw);
+        hwc_close(hwc);
     }
 
+    BenchStats stats;
+    bench_compute_stats(times, iterations, &stats);
+
+    char config[160];
+    const char *fused_names[] = {"", "/fused-axpby", "/fused-xdot", "/fused-norm2"};
+    const char *eigen_names[] = {"", "/eigen-power", "/eigen-lanczos"};
+    snprintf(config, sizeof(config), "%s/%s/%d/%d%s%s%s%s%s", is_sequential ? "sequential" : "parallel",
+             is_sequential ? "none" : schedule_str, is_sequential ? 0 : chunk_size,
+             is_sequential ? 1 : num_threads, plan ? "/plan" : "",
+             tplan ? "/transpose-" : "", tplan ? transpose_method_name(tplan->method) : "",
+             fused_names[fused], eigen_names[eigen]);
+    bench_write_results(&bench, matrix_file, config, &stats, 2.0 * mat->nz, spmv_bytes_moved(mat));
+
 #ifndef PERF_MODE
-    double p90 = calculate_90th_percentile(times, iterations);
-    printf("%.6f\n", p90);
-    fprintf(stderr, "[DEBUG] Iter: %d, 90th percentile time: %.6f sec (%.4f ms), Dummy: %.6e\n",
-            iterations, p90, p90 * 1000, dummy);
+    printf("%.6f\n", stats.p90);
+    bench_print_stats(config, &stats);
+    fprintf(stderr, "[DEBUG] Iter: %d (warm-up %d, %s cache), 90th percentile time: %.6f sec (%.4f ms), Dummy: %.6e\n",
+            iterations, n_pilot, bench.flush_cache ? "cold" : "warm", stats.p90, stats.p90 * 1000, dummy);
+    if (es) {
+        double lmin, lmax;
+        eigen_estimate(es, &lmin, &lmax);
+        if (eigen == EIGEN_POWER) {
+            fprintf(stderr, "[EIGEN] power: dominant eigenvalue %.10e after %d iterations (%.4f ms per iteration)\n",
+                    lmax, es->steps, stats.mean * 1000);
+        } else {
+            fprintf(stderr, "[EIGEN] lanczos: lambda_min %.10e lambda_max %.10e after %d iterations%s (%.4f ms per iteration)\n",
+                    lmin, lmax, es->steps, es->breakdown ? " (invariant subspace)" : "", stats.mean * 1000);
+        }
+    }
+    fprintf(stderr, "[MEM] Peak RSS: %.1f MB (CSR arena %.1f MB) alloc %s\n", peak_rss_mb(),
+            mat->arena_bytes / 1e6, alloc_policy_string());
 #else
     printf("%.6f\n", times[0]);
     fprintf(stderr, "[DEBUG PERF_MODE] Iter: %d, Dummy: %.6e\n", iterations, dummy);
 #endif
 
     free(times);
+    free_row_bins(bins);
+    free_tiled_csr(tiled);
+    free_dia(dia);
+    free_transpose_plan(tplan);
+    free_spmv_plan(plan);
+    free_eigen_state(es);
     free(x);
     free(y);
     free_matrix(mat);
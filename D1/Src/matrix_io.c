@@ -1,10 +1,58 @@
 
+#define _GNU_SOURCE
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/resource.h>
 #include "matrix_io.h"
 #include "mmio.h"
+#include "alloc.h"
+
+static size_t align_up(size_t bytes, size_t align) {
+    return (bytes + align - 1) / align * align;
+}
+
+// Ordina per colonna (stabile) il segmento J/val di una riga: insertion sort
+// sulle righe corte, merge sort bottom-up con i buffer tmp_J/tmp_v altrimenti
+static void sort_row(int *J, double *val, int n, int *tmp_J, double *tmp_v) {
+    if (n <= 32) {
+        for (int k = 1; k < n; k++) {
+            int j = J[k];
+            double v = val[k];
+            int m = k - 1;
+            while (m >= 0 && J[m] > j) {
+                J[m + 1] = J[m];
+                val[m + 1] = val[m];
+                m--;
+            }
+            J[m + 1] = j;
+            val[m + 1] = v;
+        }
+        return;
+    }
+    int *src_J = J, *dst_J = tmp_J;
+    double *src_v = val, *dst_v = tmp_v;
+    for (int width = 1; width < n; width *= 2) {
+        for (int lo = 0; lo < n; lo += 2 * width) {
+            int mid = lo + width < n ? lo + width : n;
+            int hi = lo + 2 * width < n ? lo + 2 * width : n;
+            int a = lo, b = mid, k = lo;
+            while (a < mid && b < hi) {
+                if (src_J[b] < src_J[a]) { dst_J[k] = src_J[b]; dst_v[k++] = src_v[b++]; }
+                else                     { dst_J[k] = src_J[a]; dst_v[k++] = src_v[a++]; }
+            }
+            while (a < mid) { dst_J[k] = src_J[a]; dst_v[k++] = src_v[a++]; }
+            while (b < hi)  { dst_J[k] = src_J[b]; dst_v[k++] = src_v[b++]; }
+        }
+        int *tj = src_J; src_J = dst_J; dst_J = tj;
+        double *tv = src_v; src_v = dst_v; dst_v = tv;
+    }
+    if (src_J != J) {
+        memcpy(J, src_J, n * sizeof(int));
+        memcpy(val, src_v, n * sizeof(double));
+    }
+}
 
 Matrix* read_matrix(const char *filename) {
     Matrix *mat = (Matrix*)malloc(sizeof(Matrix));
@@ -43,10 +91,20 @@ Matrix* read_matrix(const char *filename) {
        printf("Matrix size: %d x %d, NNZ (file): %d\n", mat->M, mat->N, mat->nz);
 
        // ===== ALLOCA CON MARGINE PER SIMMETRIA =====
+       // J e val vengono letti direttamente nell'arena che diventerà il CSR
+       // (prefixSum | sorted_J | sorted_val); solo I è un buffer temporaneo
        int max_nz = mm_is_symmetric(matcode) ? (2 * mat->nz) : mat->nz;
-       mat->I = (int*)malloc(max_nz * sizeof(int));
-       mat->J = (int*)malloc(max_nz * sizeof(int));
-       mat->val = (double*)malloc(max_nz * sizeof(double));
+       // Ogni array dell'arena parte su una linea di cache
+       size_t off_J = align_up((size_t)(mat->M + 1) * sizeof(int), ALLOC_LINE);
+       size_t off_val = off_J + align_up((size_t)max_nz * sizeof(int), ALLOC_LINE);
+       mat->arena_bytes = off_val + (size_t)max_nz * sizeof(double);
+       mat->arena = alloc_array(mat->arena_bytes);
+       mat->I = (int*)alloc_array((size_t)max_nz * sizeof(int));
+       mat->J = (int*)((char*)mat->arena + off_J);
+       mat->val = (double*)((char*)mat->arena + off_val);
+       mat->prefixSum = (int*)mat->arena;
+       mat->sorted_J = NULL;
+       mat->sorted_val = NULL;
 
        // ===== LEGGI ELEMENTI CON GESTIONE SIMMETRIA E PATTERN =====
        int nz_actual = 0;
@@ -97,51 +155,80 @@ void coo_to_csr(Matrix *mat) {
     printf("\nConverting COO to CSR...\n");
     
     // Conta elementi per riga
-    int *row_counts = (int*)calloc(mat->M, sizeof(int));
+    int *next_pos = (int*)alloc_zeroed(mat->M + 1, sizeof(int));
     for (int i = 0; i < mat->nz; i++) {
-        row_counts[mat->I[i]]++;
+        next_pos[mat->I[i]]++;
     }
 
-    // Calcola prefix sum
-    mat->prefixSum = (int*)malloc((mat->M + 1) * sizeof(int));
+    // Calcola prefix sum (nell'arena, davanti a J e val)
     mat->prefixSum[0] = 0;
     for (int i = 0; i < mat->M; i++) {
-        mat->prefixSum[i + 1] = mat->prefixSum[i] + row_counts[i];
+        mat->prefixSum[i + 1] = mat->prefixSum[i] + next_pos[i];
     }
-
-    // Alloca array ordinati
-    mat->sorted_J = (int*)malloc(mat->nz * sizeof(int));
-    mat->sorted_val = (double*)malloc(mat->nz * sizeof(double));
-
-    // Riempi array ordinati
-    int *next_pos = (int*)malloc((mat->M + 1) * sizeof(int));
-    for(int i = 0; i < mat->M + 1; i++) {
+    for (int i = 0; i < mat->M + 1; i++) {
         next_pos[i] = mat->prefixSum[i];
     }
 
-    for (int i = 0; i < mat->nz; i++) {
-        int row = mat->I[i];
-        int dest = next_pos[row];
-        
-        mat->sorted_val[dest] = mat->val[i];
-        mat->sorted_J[dest] = mat->J[i];
-        next_pos[row]++;
+    // Ordinamento per riga sul posto: ogni elemento fuori posto viene
+    // scambiato nella prima posizione libera della sua riga, così J e val
+    // diventano sorted_J e sorted_val senza una seconda copia
+    for (int r = 0; r < mat->M; r++) {
+        while (next_pos[r] < mat->prefixSum[r + 1]) {
+            int p = next_pos[r];
+            int row = mat->I[p];
+            if (row == r) {
+                next_pos[r]++;
+                continue;
+            }
+            int q = next_pos[row]++;
+            int ti = mat->I[q];  mat->I[q] = row;              mat->I[p] = ti;
+            int tj = mat->J[q];  mat->J[q] = mat->J[p];        mat->J[p] = tj;
+            double tv = mat->val[q]; mat->val[q] = mat->val[p]; mat->val[p] = tv;
+        }
+    }
+
+    // Gli scambi non sono stabili: si ripristinano le colonne crescenti in
+    // ogni riga, come dava lo scatter per conteggio sui file column-major
+    // di SuiteSparse (stesso accesso a x dei risultati precedenti)
+    int max_len = 0;
+    for (int r = 0; r < mat->M; r++) {
+        int len = mat->prefixSum[r + 1] - mat->prefixSum[r];
+        if (len > max_len) max_len = len;
     }
+    int *tmp_J = (int*)malloc((max_len > 0 ? max_len : 1) * sizeof(int));
+    double *tmp_v = (double*)malloc((max_len > 0 ? max_len : 1) * sizeof(double));
+    for (int r = 0; r < mat->M; r++) {
+        int begin = mat->prefixSum[r];
+        sort_row(mat->J + begin, mat->val + begin, mat->prefixSum[r + 1] - begin, tmp_J, tmp_v);
+    }
+    free(tmp_J);
+    free(tmp_v);
+
+    mat->sorted_J = mat->J;
+    mat->sorted_val = mat->val;
 
-    free(row_counts);
+    // Le coordinate COO non servono più: resta solo l'arena CSR
+    free(mat->I);
     free(next_pos);
+    mat->I = NULL;
+    mat->J = NULL;
+    mat->val = NULL;
     
-    printf("CSR conversion complete!\n");
+    printf("CSR conversion complete! (arena %.1f MB, COO row indices freed)\n",
+           mat->arena_bytes / 1e6);
+}
+
+double peak_rss_mb(void) {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0.0;
+    return usage.ru_maxrss / 1024.0;   // ru_maxrss è in KB su Linux
 }
 
 void free_matrix(Matrix *mat) {
     if (mat) {
+        // J, val e gli array CSR vivono nell'arena
         free(mat->I);
-        free(mat->J);
-        free(mat->val);
-        free(mat->prefixSum);
-        free(mat->sorted_J);
-        free(mat->sorted_val);
+        free(mat->arena);
         free(mat);
     }
 }
@@ -0,0 +1,357 @@
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "ooc.h"
+#include "csr.h"
+#include "mmio.h"
+#include "my_timer.h"
+
+// Apre un file Matrix Market e si posiziona sul primo elemento
+static FILE* open_mtx(const char *filename, MM_typecode *code, int *M, int *N, int *nz) {
+    FILE *f = fopen(filename, "r");
+    if (!f) {
+        fprintf(stderr, "Error opening file: %s\n", filename);
+        return NULL;
+    }
+    if (mm_read_banner(f, code) != 0 || !mm_is_matrix(*code) || !mm_is_sparse(*code) ||
+        mm_read_mtx_crd_size(f, M, N, nz) != 0) {
+        fprintf(stderr, "Error: %s is not a sparse Matrix Market file\n", filename);
+        fclose(f);
+        return NULL;
+    }
+    return f;
+}
+
+static int read_entry(FILE *f, MM_typecode code, int *row, int *col, double *value) {
+    *value = 1.0;  // Default per pattern
+    if (fscanf(f, "%d %d", row, col) != 2) return 0;
+    if (!mm_is_pattern(code) && fscanf(f, "%lf", value) != 1) return 0;
+    (*row)--;
+    (*col)--;
+    return 1;
+}
+
+int ooc_source_info(const char *mtx_file, long block_bytes, OocHeader *src) {
+    MM_typecode code;
+    int M, N, nz_file;
+    struct stat st;
+    memset(src, 0, sizeof(OocHeader));
+    if (stat(mtx_file, &st) != 0) return 0;
+    FILE *f = open_mtx(mtx_file, &code, &M, &N, &nz_file);
+    if (!f) return 0;
+    fclose(f);
+    src->M = M;
+    src->N = N;
+    src->nnz_file = nz_file;
+    src->source_bytes = (int64_t)st.st_size;
+    src->source_mtime = (int64_t)st.st_mtime;
+    src->block_bytes = block_bytes;
+    return 1;
+}
+
+int ooc_matches(const OocMatrix *om, const OocHeader *src) {
+    const OocHeader *h = &om->hdr;
+    return h->M == src->M && h->N == src->N && h->nnz_file == src->nnz_file &&
+           h->source_bytes == src->source_bytes && h->source_mtime == src->source_mtime &&
+           h->block_bytes == src->block_bytes;
+}
+
+// Parte intera di un blocco (row_ptr + col) arrotondata a 8 byte, così i
+// valori double che seguono sono allineati
+static int64_t block_int_bytes(int64_t rows, int64_t nnz) {
+    return ((rows + 1 + nnz) * (int64_t)sizeof(int) + 7) & ~(int64_t)7;
+}
+
+static void write_full(int fd, const void *buf, int64_t bytes, int64_t offset) {
+    const char *p = (const char*)buf;
+    while (bytes > 0) {
+        ssize_t n = pwrite(fd, p, bytes, offset);
+        if (n <= 0) {
+            perror("pwrite");
+            exit(1);
+        }
+        p += n;
+        bytes -= n;
+        offset += n;
+    }
+}
+
+static void read_full(int fd, void *buf, int64_t bytes, int64_t offset) {
+    char *p = (char*)buf;
+    while (bytes > 0) {
+        ssize_t n = pread(fd, p, bytes, offset);
+        if (n <= 0) {
+            perror("pread");
+            exit(1);
+        }
+        p += n;
+        bytes -= n;
+        offset += n;
+    }
+}
+
+int ooc_convert_mtx(const char *mtx_file, const char *ooc_file, long block_bytes) {
+    MM_typecode code;
+    int M, N, nz_file;
+    FILE *f = open_mtx(mtx_file, &code, &M, &N, &nz_file);
+    if (!f) return 1;
+    int symmetric = mm_is_symmetric(code);
+
+    printf("Out-of-core: converting %s to %s (%d x %d, NNZ (file): %d)\n",
+           mtx_file, ooc_file, M, N, nz_file);
+
+    // Passata 1: non-zero per riga (con l'espansione della simmetria)
+    int *row_nnz = (int*)calloc(M, sizeof(int));
+    int row, col;
+    double value;
+    for (int e = 0; e < nz_file; e++) {
+        if (!read_entry(f, code, &row, &col, &value)) {
+            fprintf(stderr, "Error: truncated Matrix Market file %s\n", mtx_file);
+            exit(1);
+        }
+        row_nnz[row]++;
+        if (symmetric && row != col) row_nnz[col]++;
+    }
+    fclose(f);
+
+    // Blocchi di righe consecutive da circa block_bytes su disco
+    int cap = 64, n_blocks = 0;
+    OocBlockInfo *blocks = (OocBlockInfo*)malloc(cap * sizeof(OocBlockInfo));
+    int64_t total_nnz = 0;
+    int begin = 0;
+    while (begin < M) {
+        int64_t nnz = 0;
+        int end = begin;
+        while (end < M) {
+            int64_t bytes = block_int_bytes(end + 1 - begin, nnz + row_nnz[end])
+                          + (nnz + row_nnz[end]) * (int64_t)sizeof(double);
+            if (end > begin && (bytes > block_bytes || nnz + row_nnz[end] > INT_MAX / 2)) break;
+            nnz += row_nnz[end];
+            end++;
+        }
+        if (n_blocks == cap) {
+            cap *= 2;
+            blocks = (OocBlockInfo*)realloc(blocks, cap * sizeof(OocBlockInfo));
+        }
+        blocks[n_blocks].row_begin = begin;
+        blocks[n_blocks].row_end = end;
+        blocks[n_blocks].nnz = nnz;
+        blocks[n_blocks].bytes = block_int_bytes(end - begin, nnz) + nnz * (int64_t)sizeof(double);
+        total_nnz += nnz;
+        n_blocks++;
+        begin = end;
+    }
+
+    OocHeader hdr;
+    if (!ooc_source_info(mtx_file, block_bytes, &hdr)) {
+        fprintf(stderr, "Error: cannot stat %s\n", mtx_file);
+        exit(1);
+    }
+    memcpy(hdr.magic, OOC_MAGIC, 8);
+    hdr.M = M;
+    hdr.N = N;
+    hdr.nnz = total_nnz;
+    hdr.n_blocks = n_blocks;
+
+    int64_t offset = sizeof(OocHeader) + (int64_t)n_blocks * sizeof(OocBlockInfo);
+    for (int b = 0; b < n_blocks; b++) {
+        blocks[b].offset = offset;
+        offset += blocks[b].bytes;
+    }
+
+    int fd = open(ooc_file, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "Error creating file: %s\n", ooc_file);
+        exit(1);
+    }
+    write_full(fd, &hdr, sizeof(OocHeader), 0);
+    write_full(fd, blocks, (int64_t)n_blocks * sizeof(OocBlockInfo), sizeof(OocHeader));
+
+    // Passate successive: tanti blocchi quanti ne stanno in OOC_CONVERT_BUDGET,
+    // rileggendo il file di testo e tenendo solo le righe del gruppo
+    int passes = 0;
+    int b0 = 0;
+    while (b0 < n_blocks) {
+        int b1 = b0;
+        int64_t pass_bytes = 0;
+        while (b1 < n_blocks && (b1 == b0 || pass_bytes + blocks[b1].bytes <= OOC_CONVERT_BUDGET)) {
+            pass_bytes += blocks[b1].bytes;
+            b1++;
+        }
+
+        int r0 = (int)blocks[b0].row_begin, r1 = (int)blocks[b1 - 1].row_end;
+        char *buf = (char*)malloc(pass_bytes);
+        int **col_of = (int**)malloc((r1 - r0) * sizeof(int*));
+        double **val_of = (double**)malloc((r1 - r0) * sizeof(double*));
+
+        // row_ptr relativi al blocco e puntatori di scrittura per riga
+        char *p = buf;
+        for (int b = b0; b < b1; b++) {
+            int rows = (int)(blocks[b].row_end - blocks[b].row_begin);
+            int *rp = (int*)p;
+            int *cols = rp + rows + 1;
+            double *vals = (double*)(p + block_int_bytes(rows, blocks[b].nnz));
+            rp[0] = 0;
+            for (int r = 0; r < rows; r++) {
+                int g = (int)blocks[b].row_begin + r;
+                rp[r + 1] = rp[r] + row_nnz[g];
+                col_of[g - r0] = cols + rp[r];
+                val_of[g - r0] = vals + rp[r];
+            }
+            p += blocks[b].bytes;
+        }
+
+        f = open_mtx(mtx_file, &code, &M, &N, &nz_file);
+        if (!f) exit(1);
+        for (int e = 0; e < nz_file; e++) {
+            read_entry(f, code, &row, &col, &value);
+            if (row >= r0 && row < r1) {
+                *col_of[row - r0]++ = col;
+                *val_of[row - r0]++ = value;
+            }
+            if (symmetric && row != col && col >= r0 && col < r1) {
+                *col_of[col - r0]++ = row;
+                *val_of[col - r0]++ = value;
+            }
+        }
+        fclose(f);
+
+        p = buf;
+        for (int b = b0; b < b1; b++) {
+            write_full(fd, p, blocks[b].bytes, blocks[b].offset);
+            p += blocks[b].bytes;
+        }
+
+        free(col_of);
+        free(val_of);
+        free(buf);
+        passes++;
+        b0 = b1;
+    }
+    close(fd);
+
+    printf("Out-of-core: %d blocks, %.1f MB on disk, %d write passes\n",
+           n_blocks, offset / 1e6, passes);
+
+    free(blocks);
+    free(row_nnz);
+    return 0;
+}
+
+OocMatrix* ooc_open(const char *ooc_file) {
+    int fd = open(ooc_file, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    OocMatrix *om = (OocMatrix*)calloc(1, sizeof(OocMatrix));
+    om->fd = fd;
+    if (pread(fd, &om->hdr, sizeof(OocHeader), 0) != (ssize_t)sizeof(OocHeader) ||
+        memcmp(om->hdr.magic, OOC_MAGIC, 8) != 0) {
+        fprintf(stderr, "Error: %s is not an out-of-core matrix file\n", ooc_file);
+        close(fd);
+        free(om);
+        return NULL;
+    }
+
+    om->blocks = (OocBlockInfo*)malloc(om->hdr.n_blocks * sizeof(OocBlockInfo));
+    read_full(fd, om->blocks, om->hdr.n_blocks * sizeof(OocBlockInfo), sizeof(OocHeader));
+    for (int64_t b = 0; b < om->hdr.n_blocks; b++) {
+        if (om->blocks[b].bytes > om->max_block_bytes) om->max_block_bytes = om->blocks[b].bytes;
+    }
+
+    // Lettura sequenziale: il kernel può fare read-ahead aggressivo
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    om->buffers[0] = (char*)malloc(om->max_block_bytes);
+    om->buffers[1] = (char*)malloc(om->max_block_bytes);
+    pthread_mutex_init(&om->lock, NULL);
+    pthread_cond_init(&om->cond, NULL);
+
+    printf("Out-of-core: %s, %lld x %lld, %lld nonzeros, %lld blocks (max %.1f MB)\n",
+           ooc_file, (long long)om->hdr.M, (long long)om->hdr.N, (long long)om->hdr.nnz,
+           (long long)om->hdr.n_blocks, om->max_block_bytes / 1e6);
+    return om;
+}
+
+// Thread di lettura: il blocco b va nel buffer b % 2 appena il calcolo lo libera
+static void* ooc_reader(void *arg) {
+    OocMatrix *om = (OocMatrix*)arg;
+    for (int64_t b = 0; b < om->hdr.n_blocks; b++) {
+        int slot = (int)(b % 2);
+        pthread_mutex_lock(&om->lock);
+        while (om->ready[slot] != -1) pthread_cond_wait(&om->cond, &om->lock);
+        pthread_mutex_unlock(&om->lock);
+
+        double start, stop;
+        GET_TIME(start);
+        read_full(om->fd, om->buffers[slot], om->blocks[b].bytes, om->blocks[b].offset);
+        GET_TIME(stop);
+        om->read_time += stop - start;
+        om->bytes_read += om->blocks[b].bytes;
+
+        pthread_mutex_lock(&om->lock);
+        om->ready[slot] = (int)b;
+        pthread_cond_broadcast(&om->cond);
+        pthread_mutex_unlock(&om->lock);
+    }
+    return NULL;
+}
+
+void ooc_spmv(OocMatrix *om, double *x, double *y, int num_threads,
+              int schedule_type, int chunk_size) {
+    pthread_t reader;
+    om->ready[0] = om->ready[1] = -1;
+    om->read_time = om->wait_time = om->bytes_read = 0.0;
+    pthread_create(&reader, NULL, ooc_reader, om);
+
+    for (int64_t b = 0; b < om->hdr.n_blocks; b++) {
+        int slot = (int)(b % 2);
+        double start, stop;
+
+        GET_TIME(start);
+        pthread_mutex_lock(&om->lock);
+        while (om->ready[slot] != (int)b) pthread_cond_wait(&om->cond, &om->lock);
+        pthread_mutex_unlock(&om->lock);
+        GET_TIME(stop);
+        om->wait_time += stop - start;
+
+        // Il blocco è un CSR completo: lo si moltiplica con i kernel in memoria
+        const OocBlockInfo *blk = &om->blocks[b];
+        int rows = (int)(blk->row_end - blk->row_begin);
+        Matrix view;
+        memset(&view, 0, sizeof(Matrix));
+        view.M = rows;
+        view.N = (int)om->hdr.N;
+        view.nz = (int)blk->nnz;
+        view.prefixSum = (int*)om->buffers[slot];
+        view.sorted_J = view.prefixSum + rows + 1;
+        view.sorted_val = (double*)(om->buffers[slot] + block_int_bytes(rows, blk->nnz));
+        csr_spmv_axpby(&view, 1.0, x, 0.0, y + blk->row_begin, num_threads, schedule_type, chunk_size);
+
+        pthread_mutex_lock(&om->lock);
+        om->ready[slot] = -1;
+        pthread_cond_broadcast(&om->cond);
+        pthread_mutex_unlock(&om->lock);
+    }
+
+    pthread_join(reader, NULL);
+}
+
+void ooc_close(OocMatrix *om) {
+    if (om) {
+        close(om->fd);
+        free(om->blocks);
+        free(om->buffers[0]);
+        free(om->buffers[1]);
+        pthread_mutex_destroy(&om->lock);
+        pthread_cond_destroy(&om->cond);
+        free(om);
+    }
+}
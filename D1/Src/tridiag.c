@@ -0,0 +1,46 @@
+
+#include <math.h>
+
+#include "tridiag.h"
+
+int tridiag_count_below(const double *alpha, const double *beta, int m, double x) {
+    int count = 0;
+    double d = 1.0;
+    for (int i = 0; i < m; i++) {
+        double b2 = i > 0 ? beta[i - 1] * beta[i - 1] : 0.0;
+        d = alpha[i] - x - (i > 0 ? b2 / d : 0.0);
+        // Pivot nullo: lo si sposta di poco, come nella bisezione classica
+        if (d == 0.0) d = -1e-300;
+        if (d < 0.0) count++;
+    }
+    return count;
+}
+
+// Bisezione sull'intervallo di Gershgorin per il k-esimo autovalore (da 0)
+static double bisect_kth(const double *alpha, const double *beta, int m, int k,
+                         double lo, double hi) {
+    for (int it = 0; it < TRIDIAG_BISECT_STEPS && hi - lo > 1e-14 * (fabs(lo) + fabs(hi)); it++) {
+        double mid = 0.5 * (lo + hi);
+        if (tridiag_count_below(alpha, beta, m, mid) > k) hi = mid;
+        else lo = mid;
+    }
+    return 0.5 * (lo + hi);
+}
+
+void tridiag_extreme_eigenvalues(const double *alpha, const double *beta, int m,
+                                 double *lambda_min, double *lambda_max) {
+    if (m <= 0) {
+        *lambda_min = *lambda_max = 0.0;
+        return;
+    }
+
+    double lo = alpha[0], hi = alpha[0];
+    for (int i = 0; i < m; i++) {
+        double r = (i > 0 ? fabs(beta[i - 1]) : 0.0) + (i < m - 1 ? fabs(beta[i]) : 0.0);
+        if (alpha[i] - r < lo) lo = alpha[i] - r;
+        if (alpha[i] + r > hi) hi = alpha[i] + r;
+    }
+
+    *lambda_min = bisect_kth(alpha, beta, m, 0, lo, hi);
+    *lambda_max = bisect_kth(alpha, beta, m, m - 1, lo, hi);
+}
@@ -0,0 +1,271 @@
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+
+#include "tuner.h"
+#include "csr.h"
+#include "tiled_csr.h"
+#include "dia.h"
+#include "my_timer.h"
+
+static const char *schedule_names[] = {"static", "dynamic", "guided"};
+
+const char* tune_kernel_name(int kernel) {
+    switch (kernel) {
+        case TUNE_KERNEL_BINNED: return "binned";
+        case TUNE_KERNEL_PLAN:   return "plan";
+        case TUNE_KERNEL_TILED:  return "tiled";
+        case TUNE_KERNEL_DIA:    return "dia";
+        default:                 return "csr";
+    }
+}
+
+void extract_matrix_features(Matrix *mat, MatrixFeatures *f) {
+    double sum = 0.0, sum_sq = 0.0;
+    f->row_min = mat->nz;
+    f->row_max = 0;
+    f->empty_rows = 0;
+    f->bandwidth = 0;
+
+    for (int i = 0; i < mat->M; i++) {
+        int len = mat->prefixSum[i + 1] - mat->prefixSum[i];
+        sum += len;
+        sum_sq += (double)len * len;
+        if (len < f->row_min) f->row_min = len;
+        if (len > f->row_max) f->row_max = len;
+        if (len == 0) f->empty_rows++;
+
+        for (int k = mat->prefixSum[i]; k < mat->prefixSum[i + 1]; k++) {
+            int dist = abs(mat->sorted_J[k] - i);
+            if (dist > f->bandwidth) f->bandwidth = dist;
+        }
+    }
+    f->row_mean = mat->M > 0 ? sum / mat->M : 0.0;
+    f->row_std = mat->M > 0 ? sqrt(sum_sq / mat->M - f->row_mean * f->row_mean) : 0.0;
+
+    // Blocchi 4x4 distinti: per ogni fascia di 4 righe marca le colonne-blocco
+    int n_block_cols = mat->N / 4 + 1;
+    int *stamp = (int*)malloc(n_block_cols * sizeof(int));
+    for (int b = 0; b < n_block_cols; b++) stamp[b] = -1;
+
+    long long n_blocks = 0;
+    for (int i = 0; i < mat->M; i++) {
+        int band = i / 4;
+        for (int k = mat->prefixSum[i]; k < mat->prefixSum[i + 1]; k++) {
+            int bc = mat->sorted_J[k] / 4;
+            if (stamp[bc] != band) {
+                stamp[bc] = band;
+                n_blocks++;
+            }
+        }
+    }
+    free(stamp);
+    f->block_density = n_blocks > 0 ? (double)mat->nz / (16.0 * n_blocks) : 0.0;
+}
+
+static int compare_times(const void *a, const void *b) {
+    double diff = (*(double*)a - *(double*)b);
+    if (diff > 0) return 1;
+    if (diff < 0) return -1;
+    return 0;
+}
+
+// Tempo mediano di una SpMV con la configurazione cfg
+static double time_config(Matrix *mat, TuneConfig *cfg, double *x, double *y) {
+    double times[TUNE_TRIALS];
+    RowBins *bins = NULL;
+    SpmvPlan *plan = NULL;
+    TiledCSR *tiled = NULL;
+    DiaMatrix *dia = NULL;
+
+    if (cfg->kernel == TUNE_KERNEL_BINNED) {
+        bins = csr_build_row_bins(mat, cfg->num_threads);
+    } else if (cfg->kernel == TUNE_KERNEL_TILED) {
+        tiled = csr_build_tiled(mat, detect_cache_size());
+    } else if (cfg->kernel == TUNE_KERNEL_DIA) {
+        dia = dia_build(mat->M, mat->N, mat->prefixSum, mat->sorted_J, mat->sorted_val);
+    } else if (cfg->kernel == TUNE_KERNEL_PLAN) {
+        plan = csr_plan_create(mat, cfg->num_threads, cfg->schedule, cfg->chunk_size);
+    }
+
+    if (plan) {
+        double all[TUNE_TRIALS + 1];
+        csr_plan_execute(plan, mat, x, y, TUNE_TRIALS + 1, all);
+        memcpy(times, all + 1, TUNE_TRIALS * sizeof(double));
+    } else {
+        // La prima esecuzione fa da riscaldamento e non viene misurata
+        for (int trial = -1; trial < TUNE_TRIALS; trial++) {
+            double start, stop;
+            memset(y, 0, mat->M * sizeof(double));
+            GET_TIME(start);
+            if (bins) csr_spmv_binned(mat, bins, x, y);
+            else if (tiled) csr_spmv_tiled(tiled, x, y, cfg->num_threads, cfg->chunk_size);
+            else if (dia) dia_spmv(dia, x, y, cfg->num_threads);
+            else csr_spmv_parallel_schedule(mat, x, y, cfg->num_threads, cfg->schedule, cfg->chunk_size);
+            GET_TIME(stop);
+            if (trial >= 0) times[trial] = stop - start;
+        }
+    }
+
+    free_row_bins(bins);
+    free_spmv_plan(plan);
+    free_tiled_csr(tiled);
+    free_dia(dia);
+
+    qsort(times, TUNE_TRIALS, sizeof(double), compare_times);
+    return times[TUNE_TRIALS / 2];
+}
+
+static void try_config(Matrix *mat, TuneConfig *cand, TuneConfig *best, double *x, double *y) {
+    cand->time = time_config(mat, cand, x, y);
+    printf("  [tune] %-6s %-7s chunk=%-5d threads=%-3d %.6f s\n",
+           tune_kernel_name(cand->kernel), schedule_names[cand->schedule],
+           cand->chunk_size, cand->num_threads, cand->time);
+    if (best->time <= 0.0 || cand->time < best->time) {
+        *best = *cand;
+    }
+}
+
+static int read_tune_cache(const char *path, Matrix *mat, int max_threads, TuneConfig *cfg) {
+    FILE *f = fopen(path, "r");
+    if (!f) return 0;
+
+    char key[64], value[64];
+    long long rows = -1, cols = -1, nnz = -1, threads_max = -1;
+    int found = 0;
+    cfg->time = 0.0;
+
+    while (fscanf(f, " %63[^=]=%63s", key, value) == 2) {
+        if (strcmp(key, "rows") == 0) rows = atoll(value);
+        else if (strcmp(key, "cols") == 0) cols = atoll(value);
+        else if (strcmp(key, "nnz") == 0) nnz = atoll(value);
+        else if (strcmp(key, "max_threads") == 0) threads_max = atoll(value);
+        else if (strcmp(key, "threads") == 0) { cfg->num_threads = atoi(value); found++; }
+        else if (strcmp(key, "chunk") == 0) { cfg->chunk_size = atoi(value); found++; }
+        else if (strcmp(key, "time") == 0) cfg->time = atof(value);
+        else if (strcmp(key, "kernel") == 0) {
+            cfg->kernel = strcmp(value, "binned") == 0 ? TUNE_KERNEL_BINNED :
+                          strcmp(value, "plan") == 0 ? TUNE_KERNEL_PLAN :
+                          strcmp(value, "tiled") == 0 ? TUNE_KERNEL_TILED :
+                          strcmp(value, "dia") == 0 ? TUNE_KERNEL_DIA : TUNE_KERNEL_CSR;
+            found++;
+        } else if (strcmp(key, "schedule") == 0) {
+            cfg->schedule = 0;
+            for (int s = 0; s < 3; s++) {
+                if (strcmp(value, schedule_names[s]) == 0) cfg->schedule = s;
+            }
+            found++;
+        }
+    }
+    fclose(f);
+
+    // La cache vale solo per la stessa matrice e lo stesso limite di thread
+    return found == 4 && rows == mat->M && cols == mat->N && nnz == mat->nz
+           && threads_max == max_threads && cfg->num_threads > 0 && cfg->chunk_size > 0;
+}
+
+static void write_tune_cache(const char *path, Matrix *mat, int max_threads, TuneConfig *cfg) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "Warning: cannot write tuning cache %s\n", path);
+        return;
+    }
+    fprintf(f, "rows=%d\ncols=%d\nnnz=%d\nmax_threads=%d\n", mat->M, mat->N, mat->nz, max_threads);
+    fprintf(f, "kernel=%s\nschedule=%s\nchunk=%d\nthreads=%d\ntime=%.9f\n",
+            tune_kernel_name(cfg->kernel), schedule_names[cfg->schedule],
+            cfg->chunk_size, cfg->num_threads, cfg->time);
+    fclose(f);
+}
+
+int autotune(Matrix *mat, const char *matrix_file, int max_threads, TuneConfig *best) {
+    char cache_path[4096];
+    snprintf(cache_path, sizeof(cache_path), "%s.tune", matrix_file);
+
+    if (read_tune_cache(cache_path, mat, max_threads, best)) {
+        printf("Autotune: using cached configuration from %s\n", cache_path);
+        return 1;
+    }
+
+    MatrixFeatures feat;
+    extract_matrix_features(mat, &feat);
+    printf("Autotune features: row mean=%.2f std=%.2f min=%d max=%d empty=%d bandwidth=%d block4x4 density=%.3f\n",
+           feat.row_mean, feat.row_std, feat.row_min, feat.row_max, feat.empty_rows,
+           feat.bandwidth, feat.block_density);
+
+    double *x = (double*)malloc(mat->N * sizeof(double));
+    double *y = (double*)calloc(mat->M, sizeof(double));
+    for (int i = 0; i < mat->N; i++) x[i] = 1.0;
+
+    TuneConfig cand;
+    best->time = 0.0;
+
+    // Fase 1: numero di thread con un kernel di riferimento (static, blocchi
+    // grandi), su potenze di due fino a max_threads
+    cand.kernel = TUNE_KERNEL_CSR;
+    cand.schedule = 0;
+    for (int t = 1; ; t *= 2) {
+        if (t > max_threads) t = max_threads;
+        cand.num_threads = t;
+        cand.chunk_size = mat->M / (8 * t) > 0 ? mat->M / (8 * t) : 1;
+        try_config(mat, &cand, best, x, y);
+        if (t == max_threads) break;
+    }
+    int threads = best->num_threads;
+
+    // Fase 2: schedule e chunk con il numero di thread scelto; i blocchi
+    // piccoli servono solo se le righe sono molto irregolari
+    int irregular = feat.row_std > feat.row_mean || feat.row_max > 8 * (feat.row_mean + 1);
+    int chunks[] = {10, 100, 1000};
+    cand.num_threads = threads;
+    for (int s = 0; s < 3; s++) {
+        for (int c = 0; c < 3; c++) {
+            if (s != 0 && !irregular && chunks[c] == 10) continue;
+            cand.kernel = TUNE_KERNEL_CSR;
+            cand.schedule = s;
+            cand.chunk_size = chunks[c];
+            try_config(mat, &cand, best, x, y);
+        }
+    }
+
+    // Fase 3: formati/kernel alternativi
+    if (irregular || feat.row_mean <= BIN_SHORT_MAX) {
+        cand.kernel = TUNE_KERNEL_BINNED;
+        cand.schedule = 0;
+        cand.chunk_size = 1;
+        try_config(mat, &cand, best, x, y);
+    }
+
+    // Pannelli di colonne solo se x non sta nella cache
+    if ((long)mat->N * (long)sizeof(double) > detect_cache_size()) {
+        cand.kernel = TUNE_KERNEL_TILED;
+        cand.schedule = 0;
+        cand.chunk_size = best->kernel == TUNE_KERNEL_CSR && best->schedule == 0 ? best->chunk_size : 100;
+        try_config(mat, &cand, best, x, y);
+    }
+
+    // DIA solo se il rilevatore trova diagonali dominanti
+    DiaMatrix *probe = dia_build(mat->M, mat->N, mat->prefixSum, mat->sorted_J, mat->sorted_val);
+    if (probe) {
+        free_dia(probe);
+        cand.kernel = TUNE_KERNEL_DIA;
+        cand.schedule = 0;
+        cand.chunk_size = 1;
+        try_config(mat, &cand, best, x, y);
+    }
+
+    cand = *best;
+    if (cand.kernel == TUNE_KERNEL_CSR) {
+        cand.kernel = TUNE_KERNEL_PLAN;
+        try_config(mat, &cand, best, x, y);
+    }
+
+    free(x);
+    free(y);
+
+    write_tune_cache(cache_path, mat, max_threads, best);
+    return 0;
+}
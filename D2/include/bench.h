@@ -0,0 +1,56 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+// Harness di benchmark condiviso tra D1 e D2: calibrazione del numero di
+// iterazioni, riscaldamento, statistiche robuste e output JSON/CSV
+
+#define BENCH_DEFAULT_TARGET   0.2      // secondi di misura complessivi
+#define BENCH_DEFAULT_WARMUP   3
+#define BENCH_DEFAULT_MIN      10
+#define BENCH_DEFAULT_MAX      100000
+#define BENCH_FLUSH_MIN_BYTES  (64L << 20)
+
+typedef struct {
+    double target_time;     // 0 = nessuna calibrazione, si usano min_iters iterazioni
+    int warmup;             // iterazioni scartate prima della misura
+    int min_iters;
+    int max_iters;
+    int flush_cache;        // 1 = cache svuotate prima di ogni iterazione (cold)
+    const char *json_path;  // JSON Lines, un oggetto per esecuzione (append)
+    const char *csv_path;   // CSV con intestazione (append)
+} BenchConfig;
+
+typedef struct {
+    int n;
+    double min, max, mean;
+    double median, p90, p99;
+    double ci_low, ci_high; // intervallo di confidenza al 95% della mediana
+} BenchStats;
+
+void bench_default_config(BenchConfig *cfg);
+
+// Riconosce --bench-time=, --warmup=, --min-iters=, --max-iters=, --cold,
+// --warm, --bench-json=, --bench-csv=. Restituisce 1 se l'opzione è sua,
+// -1 se il valore non è valido, 0 se non la riconosce
+int bench_parse_option(BenchConfig *cfg, const char *arg);
+
+const char* bench_options_help(void);
+
+// Numero di iterazioni misurate dato il tempo di una iterazione pilota
+int bench_iterations_for(const BenchConfig *cfg, double pilot_time);
+
+void bench_flush_cache(void);
+
+// Percentile p (0..1) su un array già ordinato, rango più vicino
+double bench_percentile(const double *sorted, int n, double p);
+
+void bench_compute_stats(const double *times, int n, BenchStats *s);
+
+void bench_print_stats(const char *label, const BenchStats *s);
+
+// flops e bytes si riferiscono a una singola iterazione; GFLOPS e banda
+// effettiva sono calcolati sulla mediana e sul P90
+void bench_write_results(const BenchConfig *cfg, const char *label, const char *config,
+                         const BenchStats *s, double flops, double bytes);
+
+#endif
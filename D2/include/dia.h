@@ -0,0 +1,37 @@
+#ifndef DIA_H
+#define DIA_H
+
+// Formato DIA condiviso tra D1 e D2: le diagonali dominanti sono memorizzate
+// senza indici di colonna, gli elementi rimanenti restano in un piccolo CSR
+
+#define DIA_MAX_DIAGS   32      // oltre questo numero DIA non conviene
+#define DIA_MIN_FILL    0.5     // frazione minima di non-zero reali su una diagonale
+#define DIA_MIN_COVER   0.9     // frazione minima dei non-zero coperta dalle diagonali
+#define DIA_BLOCK_ROWS  1024    // righe per blocco: y e le diagonali restano in cache
+
+typedef struct {
+    int n_rows, n_cols;
+    int nz;
+    int n_diags;
+    int *offsets;       // offset colonna - riga, crescenti
+    double *data;       // n_diags * n_rows, diagonale dopo diagonale (zeri di riempimento)
+    double fill;        // non-zero reali / elementi memorizzati in data
+    double coverage;    // non-zero nelle diagonali / nz
+
+    int rest_nz;        // elementi fuori dalle diagonali, in CSR
+    int *rest_ptr;
+    int *rest_col;
+    double *rest_val;
+} DiaMatrix;
+
+// Cerca le diagonali dominanti in un CSR (colonne qualsiasi ordine) e
+// costruisce il formato DIA; NULL se la struttura non è a bande
+DiaMatrix* dia_build(int n_rows, int n_cols, const int *row_ptr, const int *col,
+                     const double *val);
+
+// y = A x (sovrascrive y)
+void dia_spmv(const DiaMatrix *d, const double *x, double *y, int num_threads);
+
+void free_dia(DiaMatrix *d);
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef DIST2D_H
+#define DIST2D_H
+
+#include <mpi.h>
+#include "structures.h"
+
+// Distribuzione 2D (--dist=2d): griglia pr x pc di processi, il rank
+// (i, j) = i * pc + j possiede il blocco A[righe_i, colonne_j].
+// x_j viene ricomposto con MPI_Allgatherv lungo la colonna di processi,
+// i parziali di y_i sommati con MPI_Reduce_scatter lungo la riga:
+// volume per rank O(N / pc + M / pr) invece di O(ghost) con le righe cicliche
+
+typedef struct {
+    int pr, pc;                 // dimensioni della griglia
+    int my_row, my_col;         // coordinate del rank
+    MPI_Comm row_comm;          // stessa riga di processi (pc rank)
+    MPI_Comm col_comm;          // stessa colonna di processi (pr rank)
+
+    int row_begin, row_end;     // righe di A del blocco
+    int col_begin, col_end;     // colonne di A del blocco (= x_j)
+
+    int *x_counts, *x_displs;   // pezzi di x_j sui pr rank della colonna
+    int *y_counts;              // pezzi di y_i sui pc rank della riga
+    int x_piece, y_piece;       // elementi di x e y posseduti dal rank
+
+    double *x_block;            // x_j completo
+    double *y_partial;          // A_ij x_j, da sommare lungo la riga
+} Grid2D;
+
+// Griglia dei rank di mpi_comm e sotto-comunicatori (MPI_Dims_create); i
+// blocchi si fissano con grid2d_set_size quando M e N sono noti
+Grid2D* grid2d_create(MPI_Comm mpi_comm);
+
+void grid2d_set_size(Grid2D *g, int M, int N);
+
+// Blocco b di n elementi divisi in k parti: [start(b), start(b + 1))
+int grid2d_block_start(int n, int k, int b);
+int grid2d_block_of(int n, int k, int idx);
+
+// Proprietario dell'elemento (i, j) di una matrice M x N
+int grid2d_owner(const Grid2D *g, int M, int N, int i, int j);
+
+// y_piece = (A x)_piece; *comm_time = tempo di Allgatherv + Reduce_scatter
+void grid2d_spmv(Grid2D *g, LocalCSR *mat, double *x_piece, double *y_piece, double *comm_time);
+
+void free_grid2d(Grid2D *g);
+
+#endif
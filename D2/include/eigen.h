@@ -0,0 +1,39 @@
+#ifndef EIGEN_H
+#define EIGEN_H
+
+#include "structures.h"
+
+// Modalità a catena: l'uscita di ogni SpMV diventa l'ingresso della successiva.
+// v e w hanno my_x_dim + num_ghosts elementi: il chiamante aggiorna i ghost
+// di v (perform_ghost_exchange) prima di ogni passo
+#define EIGEN_NONE     0
+#define EIGEN_POWER    1   // potenze: autovalore di modulo massimo
+#define EIGEN_LANCZOS  2   // Lanczos (A simmetrica): autovalori estremi
+
+typedef struct {
+    int mode;
+    MPI_Comm mpi_comm;  // comunicatore dei prodotti scalari globali
+    int n_local;        // righe locali = elementi locali di x (matrice quadrata)
+    double *v;          // vettore corrente (normalizzato), con spazio per i ghost
+    double *w;          // secondo buffer: y per le potenze, v precedente per Lanczos
+    double beta_prev;
+    int steps;
+    int max_steps;
+    double *alpha;      // Lanczos: tridiagonale, uguale su tutti i rank
+    double *beta;
+    double lambda;      // potenze: quoziente di Rayleigh dell'ultimo passo
+    int breakdown;
+} EigenState;
+
+EigenState* eigen_create(LocalCSR *mat, MPI_Comm mpi_comm, int x_dim, int mode, int max_steps);
+
+// Un passo: SpMV locale, prodotti scalari globali (MPI_Allreduce) e normalizzazione
+void eigen_step(EigenState *es, LocalCSR *mat);
+
+void eigen_estimate(EigenState *es, double *lambda_min, double *lambda_max);
+
+const char* eigen_mode_name(int mode);
+
+void free_eigen_state(EigenState *es);
+
+#endif
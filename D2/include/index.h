@@ -0,0 +1,16 @@
+#ifndef INDEX_H
+#define INDEX_H
+
+#include <stdint.h>
+
+// Larghezza degli indici: con -DSPMV_INDEX64 conteggi di nonzeri e puntatori
+// di riga passano a 64 bit (matrici oltre 2^31 nonzeri). Le colonne locali
+// restano int: dopo la rimappatura sono < my_x_dim + num_ghosts e 32 bit
+// tengono basso il traffico di memoria del kernel
+#ifdef SPMV_INDEX64
+typedef int64_t spmv_nnz_t;
+#else
+typedef int spmv_nnz_t;
+#endif
+
+#endif
@@ -1,14 +1,16 @@
 #ifndef MATRIX_IO_H
 #define MATRIX_IO_H
 
+#include "index.h"
+
 typedef struct {
     int M;              
     int N;               
-    int nz;             
+    spmv_nnz_t nz;      
     int is_symmetric;
     int *I, *J;         
     double *val;        
-    int *prefixSum;     
+    spmv_nnz_t *prefixSum;
     int *sorted_J;      
     double *sorted_val; 
 } Matrix;
@@ -0,0 +1,24 @@
+#ifndef REPARTITION_H
+#define REPARTITION_H
+
+#include "structures.h"
+
+// --adaptive=<n>: dopo n iterazioni di prova si misura il tempo di calcolo
+// di ogni rank e si ridistribuiscono le righe in blocchi contigui di costo
+// uguale, stimato dal tempo osservato (non solo dai nonzeri)
+
+#define REPART_ROW_WEIGHT  2.0   // costo fisso di una riga, in nonzeri equivalenti
+
+// Tempo medio di una SpMV locale (ghost già scambiati) su n_iter iterazioni
+double repartition_measure(LocalCSR *mat, CommInfo *comm, int x_dim, int n_iter);
+
+// Nuova partizione pesata sul costo osservato my_time; sposta le righe tra i
+// rank, ricostruisce mat e comm. Restituisce la partizione (da liberare con
+// free_partition dopo mat) e in *rows_moved le righe cambiate di rank (globale).
+// La stessa partizione regola righe e x: solo matrici quadrate (M_glob == N_glob)
+Partition* repartition_by_cost(LocalCSR *mat, CommInfo *comm, double my_time,
+                               int M_glob, int N_glob, long long *rows_moved);
+
+void free_partition(Partition *part);
+
+#endif
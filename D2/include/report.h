@@ -0,0 +1,43 @@
+#ifndef REPORT_H
+#define REPORT_H
+
+#include <mpi.h>
+
+// Raccolta dei risultati per run con collettive: nessun giro di barriere
+// per rank, costo O(log P) in latenza anche con migliaia di rank
+
+#define REPORT_CSV_HEADER "matrix_name,rank,num_procs,run,elapsed_time,comm_time,local_nz,ghost_entries,local_flops\n"
+#define REPORT_LINE_MAX   256
+
+typedef struct {
+    MPI_Comm mpi_comm;
+    const char *name;
+    int rank, size;
+    long long local_nz;
+    int ghosts;
+    long long flops;
+} ReportInfo;
+
+// Righe CSV di tutti i rank in ordine di rank: con file == NULL il rank 0 le
+// raccoglie (MPI_Gatherv) e le stampa, altrimenti ogni rank scrive la sua
+// parte dello stesso file con MPI-IO
+void report_runs(const ReportInfo *info, const double *total, const double *comm,
+                 int repeats, const char *file);
+
+// min, media, max e P90 per fase (elapsed, comm, compute = elapsed - comm)
+// su tutti i rank e tutte le run; stampa del rank 0
+void report_phase_stats(const ReportInfo *info, const double *total, const double *comm, int repeats);
+
+// --ensemble: ogni gruppo riduce il suo tempo di ciclo (rank più lento) e i
+// flop, i rank 0 dei gruppi raccolgono i record sul rank 0 di MPI_COMM_WORLD
+// che stampa SpMV al secondo e GFLOPs per gruppo e il totale del job
+typedef struct {
+    char name[64];
+    int group, size, repeats;
+    double loop_time;
+    double flops;       // flop di una SpMV del gruppo
+} EnsembleRecord;
+
+void report_ensemble(const ReportInfo *info, int group, int repeats, double loop_time);
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdint.h>
+#include <mpi.h>
+#include "structures.h"
+
+// --snapshot=<file>: LocalCSR e CommInfo di ogni rank salvati in un solo file
+// binario con MPI-IO. Un nuovo job con la stessa configurazione (stesso numero
+// di rank, distribuzione e matrice) salta lettura, scatter e ricerca dei ghost
+
+#define SNAPSHOT_MAGIC     "SPMVSNP2"
+#define SNAPSHOT_NAME_MAX  256
+
+// Distribuzione salvata: deve coincidere con quella richiesta dal nuovo job
+#define SNAPSHOT_CYCLIC      0   // righe cicliche, schema dei ghost
+#define SNAPSHOT_REPLICATED  1   // righe cicliche, x replicato
+#define SNAPSHOT_GRID2D      2   // blocchi 2D (la griglia si ricava da M, N e size)
+#define SNAPSHOT_BLOCKS      3   // blocchi contigui di --adaptive, con la partizione
+
+// Layout del file:
+//   SnapshotHeader
+//   int64 offset[size]            posizione del blocco di ogni rank
+//   int32 first_row[size + 1]     solo per SNAPSHOT_BLOCKS
+//   per ogni rank: SnapshotRank, row_ptr (index_bytes per elemento), col_ind,
+//   val e gli array di CommInfo indicati da SnapshotRank.arrays, in quest'ordine
+typedef struct {
+    char magic[8];
+    int32_t size, kind;
+    int32_t M, N;
+    int32_t index_bytes;            // sizeof(spmv_nnz_t) del programma che ha scritto
+    int32_t reserved;
+    int64_t nz;
+    int64_t source_bytes;           // dimensione e mtime del file della matrice
+    int64_t source_mtime;           // (0 per le matrici sintetiche)
+    char name[SNAPSHOT_NAME_MAX];   // file della matrice o parametri sintetici
+} SnapshotHeader;
+
+#define SNAPSHOT_SEND_COUNTS    1
+#define SNAPSHOT_RECV_COUNTS    2
+#define SNAPSHOT_SDISPLS        4
+#define SNAPSHOT_RDISPLS        8
+#define SNAPSHOT_EXPORT        16
+#define SNAPSHOT_GHOST_GLOBALS 32
+
+typedef struct {
+    int64_t n_local_nz;
+    int32_t n_local_rows;
+    int32_t num_ghosts, total_to_send;
+    int32_t exchange_mode;
+    int32_t arrays;         // SNAPSHOT_* degli array di CommInfo presenti
+    int32_t reserved;
+} SnapshotRank;
+
+// Dimensione e mtime del file della matrice in hdr (stat sul rank 0, diffusi):
+// un .mtx modificato o sostituito allo stesso percorso invalida lo snapshot
+void snapshot_stamp_source(const char *matrix_file, MPI_Comm mpi_comm, SnapshotHeader *hdr);
+
+// Intestazione del file (letta dal rank 0 e diffusa); 0 se manca o non è uno snapshot
+int snapshot_probe(const char *file, MPI_Comm mpi_comm, SnapshotHeader *hdr);
+
+// Ripristina righe locali e schema di comunicazione; per SNAPSHOT_BLOCKS
+// alloca *part (da liberare con free_partition)
+void snapshot_read(const char *file, MPI_Comm mpi_comm, const SnapshotHeader *hdr,
+                   LocalCSR *mat, CommInfo *comm, Partition **part);
+
+// Scrittura collettiva: il rank 0 scrive intestazione e partizione, ogni rank
+// il suo blocco alla posizione data da MPI_Exscan delle dimensioni.
+// Restituisce i byte totali del file
+long long snapshot_write(const char *file, MPI_Comm mpi_comm, const SnapshotHeader *hdr,
+                         const LocalCSR *mat, const CommInfo *comm, const Partition *part);
+
+#endif
@@ -2,19 +2,91 @@
 #define STRUCTURES_H
 
 #include <mpi.h>
+#include "dia.h"
+#include "index.h"
+
+#ifdef SPMV_INDEX64
+#define MPI_SPMV_NNZ MPI_INT64_T
+#else
+#define MPI_SPMV_NNZ MPI_INT
+#endif
+
+#define LARGE_COUNT_CHUNK (1 << 30)   // elementi per blocco dei tipi derivati
+
+// Conteggi oltre INT_MAX con MPI 3: per count > INT_MAX restituisce un tipo
+// derivato che copre tutto il buffer e *n = 1, altrimenti base e *n = count.
+// Il tipo va rilasciato con free_large_count_type
+MPI_Datatype large_count_type(MPI_Count count, MPI_Datatype base, int *n);
+void free_large_count_type(MPI_Datatype type, MPI_Datatype base);
 
 #define GET_OWNER(glob_idx, size) ((glob_idx) % (size))
 #define GET_LOCAL_IDX(glob_idx, size) ((glob_idx) / (size))
 
+// Partizione a blocchi prodotta da --adaptive: il rank p possiede le righe
+// (e gli elementi di x) [first_row[p], first_row[p+1]). NULL = ciclica
+typedef struct {
+    int n_glob;
+    int *first_row;     // size + 1 elementi
+} Partition;
+
+int partition_owner(const Partition *part, int g, int size);
+int partition_local(const Partition *part, int g, int size);
+int partition_global(const Partition *part, int local, int rank, int size);
+int partition_count(const Partition *part, int n_glob, int rank, int size);
+
 typedef struct {
     int n_local_rows;
-    int n_local_nz;
-    int *row_ptr;
-    int *col_ind;
+    spmv_nnz_t n_local_nz;
+    spmv_nnz_t *row_ptr;
+    int *col_ind;           // colonne locali, sempre a 32 bit
     double *val;
+    DiaMatrix *dia;     // se non NULL compute_spmv usa il formato DIA
+    double *dia_tmp;    // n_local_rows: A x per compute_spmv_axpby con DIA
+    const Partition *part;  // distribuzione delle righe, NULL = ciclica
 } LocalCSR;
 
+// Scambio ghost compresso (--ghost-delta): per ogni vicino un messaggio
+// [GhostDeltaHeader][bitmap][valori cambiati], di lunghezza variabile
+#define GHOST_DELTA_FULL    0   // tutti i valori in double, senza bitmap
+#define GHOST_DELTA_DOUBLE  1   // bitmap + valori cambiati in double
+#define GHOST_DELTA_FLOAT   2   // bitmap + valori cambiati in float
+#define GHOST_DELTA_TAG     40
+#define GHOST_DELTA_DEFAULT_REFRESH 10
+
 typedef struct {
+    int kind;
+    int n_values;
+} GhostDeltaHeader;
+
+typedef struct {
+    double tol;             // si invia solo se |x - ultimo inviato| > tol
+    int use_float;
+    int refresh_every;      // ogni refresh_every scambi un invio completo esatto
+    long exchanges;
+
+    double *last_sent;      // total_to_send: valori che il ricevente possiede
+    double *ghost_cache;    // num_ghosts: copia persistente dei ghost ricevuti
+    char *send_bytes, *recv_bytes;
+    long *sbyte_displs, *rbyte_displs;
+    long *send_len;
+    MPI_Request *reqs;
+
+    double bytes_sent;      // cumulativi, azzerati da chi misura
+    double bytes_plain;     // byte che lo scambio normale avrebbe inviato
+} GhostDelta;
+
+// --exchange: come si impacchettano e ricevono i ghost
+#define EXCHANGE_PACK      0   // pack in send_buffer, recv_buffer, copia in x
+#define EXCHANGE_DIRECT    1   // pack in send_buffer, ricezione diretta in x (default)
+#define EXCHANGE_DATATYPE  2   // tipi indicizzati: MPI legge da x e scrive in x
+#define EXCHANGE_REPLICATED 3  // x intero su ogni rank con MPI_Allgatherv, niente ghost
+
+// --replicate-x=auto: x replicato se N non supera questa soglia (x da 256 KB,
+// sta in L2), dove lo schema dei ghost costa più di un Allgatherv
+#define REPLICATE_AUTO_MAX_N 32768
+
+typedef struct {
+    MPI_Comm mpi_comm;      // comunicatore della distribuzione (gruppo con --ensemble)
     int num_ghosts;
     int total_to_send;
     
@@ -27,8 +99,37 @@ typedef struct {
     int *rdispls;
     
     int *export_indices;     
+    int *ghost_globals;      // indice globale di ogni ghost, nell'ordine di full_x
+
+    GhostDelta *delta;       // se non NULL lo scambio usa la compressione
+
+    int exchange_mode;
+    MPI_Datatype *send_types;   // EXCHANGE_DATATYPE: un tipo indicizzato per destinazione
+    MPI_Datatype *recv_types;
+    int *type_counts;           // 1 se c'è un tipo per la destinazione, 0 altrimenti
+    int *type_displs;           // spostamenti in byte per MPI_Alltoallw
+    int *rdispls_bytes;
 } CommInfo;
 
+// --overlap: righe interne calcolate mentre un task fa avanzare lo scambio ghost
+#define OVERLAP_NONE  0
+#define OVERLAP_TASK  1   // un task di comunicazione (MPI_THREAD_SERIALIZED)
+#define OVERLAP_P2P   2   // un task per gruppo di vicini (MPI_THREAD_MULTIPLE)
+#define OVERLAP_TAG   41
+#define OVERLAP_TASKS_PER_THREAD 4
+#define OVERLAP_MIN_TASK_ROWS    64
+
+typedef struct {
+    int mode;
+    int n_interior, n_boundary;
+    int *interior_rows;     // righe con sole colonne locali
+    int *boundary_rows;     // righe che leggono almeno un ghost
+    int task_rows;          // righe per task
+    int n_neighbors, n_groups;
+    int *neighbors;         // rank con cui si scambiano ghost
+    MPI_Request *reqs;
+} OverlapPlan;
+
 void free_local_csr(LocalCSR *mat);
 void free_comm_info(CommInfo *comm);
 
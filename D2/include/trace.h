@@ -0,0 +1,32 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <mpi.h>
+
+// Tracciamento leggero delle fasi (--trace): ogni thread scrive in un suo
+// buffer circolare, i tempi sono riportati al clock del rank 0 e alla fine
+// si scrive un file JSON per Chrome trace / Perfetto (chrome://tracing,
+// ui.perfetto.dev), unico oppure uno per rank
+
+#define TRACE_RING_EVENTS   65536   // eventi per thread, i più vecchi vengono sovrascritti
+#define TRACE_SYNC_ROUNDS   10      // ping-pong per stimare lo scarto dei clock
+
+typedef struct {
+    const char *name;       // stringa costante
+    double t_begin, t_end;  // MPI_Wtime locale
+} TraceEvent;
+
+extern int trace_enabled;
+
+// path: file unico (scritto dal rank 0) o prefisso per <path>.rank<N>.json
+void trace_init(const char *path, int per_rank);
+
+void trace_event(const char *name, double t_begin, double t_end);
+
+// Raccoglie gli eventi e scrive il file; collettiva su MPI_COMM_WORLD
+void trace_finalize(void);
+
+#define TRACE_BEGIN(t)      double t = trace_enabled ? MPI_Wtime() : 0.0
+#define TRACE_END(name, t)  do { if (trace_enabled) trace_event(name, t, MPI_Wtime()); } while (0)
+
+#endif
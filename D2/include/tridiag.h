@@ -0,0 +1,15 @@
+#ifndef TRIDIAG_H
+#define TRIDIAG_H
+
+// Autovalori estremi della matrice tridiagonale simmetrica di Lanczos
+// (condiviso tra D1 e D2): diagonale alpha[0..m-1], sottodiagonale beta[0..m-2]
+
+#define TRIDIAG_BISECT_STEPS 100
+
+// Numero di autovalori minori di x (successione di Sturm)
+int tridiag_count_below(const double *alpha, const double *beta, int m, double x);
+
+void tridiag_extreme_eigenvalues(const double *alpha, const double *beta, int m,
+                                 double *lambda_min, double *lambda_max);
+
+#endif
@@ -1,7 +1,7 @@
 #!/bin/bash
 
 
-MY_SOURCES="../src/main.c ../src/io_setup.c ../src/computation.c ../src/communication.c ../src/matrix_io.c ../src/mmio.c"
+MY_SOURCES="../src/main.c ../src/io_setup.c ../src/computation.c ../src/communication.c ../src/matrix_io.c ../src/mmio.c ../src/bench.c ../src/dia.c ../src/alloc.c ../src/tridiag.c ../src/eigen.c ../src/overlap.c ../src/trace.c ../src/report.c ../src/repartition.c ../src/dist2d.c ../src/snapshot.c"
 
 EXEC_MPI="../results/spmv_mpi.out"
 EXEC_HYBRID="../results/spmv_hybrid.out"
@@ -55,7 +55,7 @@ compile_code() {
 
     # 1. Compilazione MPI Pura
     echo "🔨 Compilazione MPI Pura..."
-    $MPICC $CFLAGS_MPI $MY_SOURCES -o "$EXEC_MPI"
+    $MPICC $CFLAGS_MPI $MY_SOURCES -o "$EXEC_MPI" -lm
     
     if [ $? -ne 0 ]; then
         echo "❌ Errore compilazione MPI!"
@@ -64,7 +64,7 @@ compile_code() {
     echo "✅ MPI compilato."
 
     echo "🔨 Compilazione Hybrid..."
-    $MPICC $CFLAGS_HYBRID $MY_SOURCES -o "$EXEC_HYBRID"
+    $MPICC $CFLAGS_HYBRID $MY_SOURCES -o "$EXEC_HYBRID" -lm
     
     if [ $? -ne 0 ]; then
         echo "❌ Errore compilazione Hybrid!"
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <mpi.h>
 
 #ifdef _OPENMP
@@ -11,14 +12,19 @@
     #define omp_get_num_threads() 1
 #endif
 #include "structures.h"
+#include "trace.h"
 
-void setup_communication_pattern(LocalCSR *mat, CommInfo *comm, int rank, int size, int N_globale) {
+void setup_communication_pattern(LocalCSR *mat, CommInfo *comm, MPI_Comm mpi_comm, int N_globale) {
+    int rank, size;
+    MPI_Comm_rank(mpi_comm, &rank);
+    MPI_Comm_size(mpi_comm, &size);
+    comm->mpi_comm = mpi_comm;
     int *ghost_flags = calloc(N_globale, sizeof(int));
     int n_ghosts = 0;
 
-    for (int i = 0; i < mat->n_local_nz; i++) {
+    for (spmv_nnz_t i = 0; i < mat->n_local_nz; i++) {
         int g_col = mat->col_ind[i];
-        if (GET_OWNER(g_col, size) != rank) {
+        if (partition_owner(mat->part, g_col, size) != rank) {
             if (ghost_flags[g_col] == 0) {
                 ghost_flags[g_col] = 1;
                 n_ghosts++;
@@ -27,98 +33,426 @@ void setup_communication_pattern(LocalCSR *mat, CommInfo *comm, int rank, int si
     }
     comm->num_ghosts = n_ghosts;
 
-    int *requested_ghosts = malloc(n_ghosts * sizeof(int));
+    comm->send_counts = calloc(size, sizeof(int));
+    comm->recv_counts = calloc(size, sizeof(int));
+
+    for (int c = 0; c < N_globale; c++) {
+        if (ghost_flags[c]) comm->recv_counts[partition_owner(mat->part, c, size)]++;
+    }
+
+    MPI_Alltoall(comm->recv_counts, 1, MPI_INT, comm->send_counts, 1, MPI_INT, comm->mpi_comm);
+
+    comm->sdispls = malloc(size * sizeof(int));
+    comm->rdispls = malloc(size * sizeof(int));
+    comm->sdispls[0] = 0; comm->rdispls[0] = 0;
+    for(int p=1; p<size; p++) {
+        comm->sdispls[p] = comm->sdispls[p-1] + comm->send_counts[p-1];
+        comm->rdispls[p] = comm->rdispls[p-1] + comm->recv_counts[p-1];
+    }
+
+    // recv_buffer arriva raggruppato per proprietario (rdispls): i ghost
+    // vanno numerati nello stesso ordine, non in ordine globale crescente
+    int *sorted_reqs = malloc(n_ghosts * sizeof(int));
     int *remap_array = malloc(N_globale * sizeof(int));
     memset(remap_array, -1, N_globale * sizeof(int)); 
+    int *offsets = calloc(size, sizeof(int));
+    memcpy(offsets, comm->rdispls, size * sizeof(int));
 
-    int count = 0;
     for (int c = 0; c < N_globale; c++) {
         if (ghost_flags[c]) {
-            requested_ghosts[count] = c;
-            remap_array[c] = count; 
-            count++;
+            int pos = offsets[partition_owner(mat->part, c, size)]++;
+            sorted_reqs[pos] = c;
+            remap_array[c] = pos;
         }
     }
     free(ghost_flags);
+    free(offsets);
 
     
-    int my_x_dim = 0; 
-    for(int k=0; k<N_globale; k++) if(GET_OWNER(k, size) == rank) my_x_dim++;
+    int my_x_dim = partition_count(mat->part, N_globale, rank, size);
 
-    for (int i = 0; i < mat->n_local_nz; i++) {
+    for (spmv_nnz_t i = 0; i < mat->n_local_nz; i++) {
         int g_col = mat->col_ind[i];
-        if (GET_OWNER(g_col, size) == rank) {
-            mat->col_ind[i] = GET_LOCAL_IDX(g_col, size);
+        if (partition_owner(mat->part, g_col, size) == rank) {
+            mat->col_ind[i] = partition_local(mat->part, g_col, size);
         } else {
             mat->col_ind[i] = my_x_dim + remap_array[g_col];
         }
     }
     free(remap_array);
 
-    comm->send_counts = calloc(size, sizeof(int));
-    comm->recv_counts = calloc(size, sizeof(int));
-
-    for(int i=0; i<n_ghosts; i++) {
-        comm->recv_counts[GET_OWNER(requested_ghosts[i], size)]++;
-    }
-
-    MPI_Alltoall(comm->recv_counts, 1, MPI_INT, comm->send_counts, 1, MPI_INT, MPI_COMM_WORLD);
-
-    comm->sdispls = malloc(size * sizeof(int));
-    comm->rdispls = malloc(size * sizeof(int));
-    comm->sdispls[0] = 0; comm->rdispls[0] = 0;
-    for(int p=1; p<size; p++) {
-        comm->sdispls[p] = comm->sdispls[p-1] + comm->send_counts[p-1];
-        comm->rdispls[p] = comm->rdispls[p-1] + comm->recv_counts[p-1];
-    }
-
     comm->total_to_send = comm->sdispls[size-1] + comm->send_counts[size-1];
     int *indices_to_export = malloc(comm->total_to_send * sizeof(int));
-    
-    int *sorted_reqs = malloc(n_ghosts * sizeof(int));
-    int *offsets = calloc(size, sizeof(int));
-    memcpy(offsets, comm->rdispls, size * sizeof(int));
-
-    for(int i=0; i<n_ghosts; i++) {
-        int owner = GET_OWNER(requested_ghosts[i], size);
-        sorted_reqs[offsets[owner]++] = requested_ghosts[i];
-    }
-    free(requested_ghosts); free(offsets);
 
     MPI_Alltoallv(sorted_reqs, comm->recv_counts, comm->rdispls, MPI_INT,
-                  indices_to_export, comm->send_counts, comm->sdispls, MPI_INT, MPI_COMM_WORLD);
+                  indices_to_export, comm->send_counts, comm->sdispls, MPI_INT, comm->mpi_comm);
     
+    // Le richieste sono in ordine globale crescente per proprietario, quindi
+    // gli indici locali di ogni segmento sono già ordinati: il pack legge x
+    // in avanti
     comm->export_indices = malloc(comm->total_to_send * sizeof(int));
     for(int i=0; i<comm->total_to_send; i++) {
-        comm->export_indices[i] = GET_LOCAL_IDX(indices_to_export[i], size);
+        comm->export_indices[i] = partition_local(mat->part, indices_to_export[i], size);
     }
 
     comm->send_buffer = malloc(comm->total_to_send * sizeof(double));
     comm->recv_buffer = malloc(n_ghosts * sizeof(double));
+    comm->exchange_mode = EXCHANGE_DIRECT;
 
-    free(sorted_reqs);
+    // Servono per riportare le colonne a indici globali (ridistribuzione)
+    comm->ghost_globals = sorted_reqs;
     free(indices_to_export);
 }
 
+// x replicato: le colonne restano globali a meno di una rotazione che mette
+// prima gli elementi locali, poi quelli dei rank successivi (rank + 1, ...).
+// Con i blocchi di ogni proprietario contigui MPI_Allgatherv in place riempie
+// x senza copie e la x locale resta in full_x[0, my_x_dim) come con i ghost
+void setup_replicated_x(LocalCSR *mat, CommInfo *comm, MPI_Comm mpi_comm, int N_globale) {
+    int rank, size;
+    MPI_Comm_rank(mpi_comm, &rank);
+    MPI_Comm_size(mpi_comm, &size);
+    comm->mpi_comm = mpi_comm;
+    comm->recv_counts = malloc(size * sizeof(int));
+    comm->rdispls = malloc(size * sizeof(int));
+    int pos = 0;
+    for (int k = 0; k < size; k++) {
+        int p = (rank + k) % size;
+        comm->recv_counts[p] = partition_count(mat->part, N_globale, p, size);
+        comm->rdispls[p] = pos;
+        pos += comm->recv_counts[p];
+    }
+
+    for (spmv_nnz_t i = 0; i < mat->n_local_nz; i++) {
+        int g_col = mat->col_ind[i];
+        int p = partition_owner(mat->part, g_col, size);
+        mat->col_ind[i] = comm->rdispls[p] + partition_local(mat->part, g_col, size);
+    }
+
+    int my_x_dim = comm->recv_counts[rank];
+    comm->num_ghosts = N_globale - my_x_dim;
+    comm->total_to_send = my_x_dim * (size - 1);
+    comm->exchange_mode = EXCHANGE_REPLICATED;
+}
+
+MPI_Datatype large_count_type(MPI_Count count, MPI_Datatype base, int *n) {
+    if (count <= INT_MAX) {
+        *n = (int)count;
+        return base;
+    }
+    // count = chunks * LARGE_COUNT_CHUNK + resto: un vettore di blocchi pieni
+    // e un blocco contiguo per il resto, uniti in un tipo solo
+    MPI_Count chunks = count / LARGE_COUNT_CHUNK, rest = count % LARGE_COUNT_CHUNK;
+    MPI_Datatype full, tail, type;
+    MPI_Aint lb, extent;
+    MPI_Type_get_extent(base, &lb, &extent);
+    MPI_Type_vector((int)chunks, LARGE_COUNT_CHUNK, LARGE_COUNT_CHUNK, base, &full);
+    MPI_Type_contiguous((int)rest, base, &tail);
+    int blocks[2] = {1, 1};
+    MPI_Aint displs[2] = {0, (MPI_Aint)(chunks * LARGE_COUNT_CHUNK) * extent};
+    MPI_Datatype types[2] = {full, tail};
+    MPI_Type_create_struct(2, blocks, displs, types, &type);
+    MPI_Type_commit(&type);
+    MPI_Type_free(&full);
+    MPI_Type_free(&tail);
+    *n = 1;
+    return type;
+}
+
+void free_large_count_type(MPI_Datatype type, MPI_Datatype base) {
+    if (type != base) MPI_Type_free(&type);
+}
+
+void free_comm_info(CommInfo *comm) {
+    int size;
+    MPI_Comm_size(comm->mpi_comm, &size);
+    if (comm->send_types) {
+        for (int p = 0; p < size; p++) {
+            if (comm->type_counts[p]) MPI_Type_free(&comm->send_types[p]);
+        }
+    }
+    free(comm->send_types); free(comm->recv_types);
+    free(comm->type_counts); free(comm->type_displs); free(comm->rdispls_bytes);
+    if (comm->delta) {
+        GhostDelta *gd = comm->delta;
+        free(gd->last_sent); free(gd->ghost_cache);
+        free(gd->send_bytes); free(gd->recv_bytes);
+        free(gd->sbyte_displs); free(gd->rbyte_displs);
+        free(gd->send_len); free(gd->reqs);
+        free(gd);
+    }
+    free(comm->send_buffer); free(comm->recv_buffer);
+    free(comm->send_counts); free(comm->recv_counts);
+    free(comm->sdispls); free(comm->rdispls);
+    free(comm->export_indices);
+    free(comm->ghost_globals);
+    MPI_Comm mpi_comm = comm->mpi_comm;
+    memset(comm, 0, sizeof(CommInfo));
+    comm->mpi_comm = mpi_comm;
+}
+
+void setup_exchange(CommInfo *comm, int mode) {
+    comm->exchange_mode = mode;
+    if (mode != EXCHANGE_DATATYPE || comm->send_types) return;
+
+    int size;
+    MPI_Comm_size(comm->mpi_comm, &size);
+    comm->send_types = malloc(size * sizeof(MPI_Datatype));
+    comm->recv_types = malloc(size * sizeof(MPI_Datatype));
+    comm->type_counts = malloc(size * sizeof(int));
+    comm->type_displs = calloc(size, sizeof(int));
+    comm->rdispls_bytes = malloc(size * sizeof(int));
+
+    // Un blocco da un double per ogni indice esportato: MPI raccoglie i
+    // valori direttamente da x, senza send_buffer
+    for (int p = 0; p < size; p++) {
+        comm->recv_types[p] = MPI_DOUBLE;
+        comm->rdispls_bytes[p] = comm->rdispls[p] * (int)sizeof(double);
+        if (comm->send_counts[p] > 0) {
+            MPI_Type_create_indexed_block(comm->send_counts[p], 1, comm->export_indices + comm->sdispls[p],
+                                          MPI_DOUBLE, &comm->send_types[p]);
+            MPI_Type_commit(&comm->send_types[p]);
+            comm->type_counts[p] = 1;
+        } else {
+            comm->send_types[p] = MPI_DOUBLE;
+            comm->type_counts[p] = 0;
+        }
+    }
+}
+
+const char* exchange_mode_name(int mode) {
+    return mode == EXCHANGE_PACK ? "pack" : mode == EXCHANGE_DATATYPE ? "datatype" :
+           mode == EXCHANGE_REPLICATED ? "replicated" : "direct";
+}
+
+// Byte massimi di un messaggio compresso con n valori: intestazione, bitmap
+// arrotondata a 8 byte, valori in double
+static long ghost_delta_max_bytes(int n) {
+    return (long)sizeof(GhostDeltaHeader) + (long)(n + 63) / 64 * 8 + (long)n * sizeof(double);
+}
+
+void setup_ghost_delta(CommInfo *comm, double tol, int use_float, int refresh_every) {
+    int size;
+    MPI_Comm_size(comm->mpi_comm, &size);
+
+    GhostDelta *gd = calloc(1, sizeof(GhostDelta));
+    gd->tol = tol;
+    gd->use_float = use_float;
+    gd->refresh_every = refresh_every > 0 ? refresh_every : GHOST_DELTA_DEFAULT_REFRESH;
+    gd->last_sent = calloc(comm->total_to_send > 0 ? comm->total_to_send : 1, sizeof(double));
+    gd->ghost_cache = calloc(comm->num_ghosts > 0 ? comm->num_ghosts : 1, sizeof(double));
+
+    gd->sbyte_displs = malloc((size + 1) * sizeof(long));
+    gd->rbyte_displs = malloc((size + 1) * sizeof(long));
+    gd->send_len = calloc(size, sizeof(long));
+    gd->sbyte_displs[0] = gd->rbyte_displs[0] = 0;
+    for (int p = 0; p < size; p++) {
+        gd->sbyte_displs[p+1] = gd->sbyte_displs[p] + (comm->send_counts[p] ? ghost_delta_max_bytes(comm->send_counts[p]) : 0);
+        gd->rbyte_displs[p+1] = gd->rbyte_displs[p] + (comm->recv_counts[p] ? ghost_delta_max_bytes(comm->recv_counts[p]) : 0);
+    }
+    gd->send_bytes = malloc(gd->sbyte_displs[size] > 0 ? gd->sbyte_displs[size] : 8);
+    gd->recv_bytes = malloc(gd->rbyte_displs[size] > 0 ? gd->rbyte_displs[size] : 8);
+    gd->reqs = malloc(2 * size * sizeof(MPI_Request));
+    comm->delta = gd;
+}
+
+// Impacchetta i valori per un vicino; restituisce la lunghezza del messaggio
+static long ghost_delta_pack(GhostDelta *gd, int full, const double *full_x,
+                             const int *export_idx, double *last, int n, char *msg) {
+    GhostDeltaHeader h;
+    char *payload = msg + sizeof(GhostDeltaHeader);
+
+    if (full) {
+        // Aggiornamento completo esatto: riallinea il ricevente
+        double *vals = (double*)payload;
+        for (int k = 0; k < n; k++) {
+            vals[k] = full_x[export_idx[k]];
+            last[k] = vals[k];
+        }
+        h.kind = GHOST_DELTA_FULL;
+        h.n_values = n;
+        memcpy(msg, &h, sizeof(h));
+        return (long)sizeof(h) + (long)n * sizeof(double);
+    }
+
+    unsigned long long *bitmap = (unsigned long long*)payload;
+    int n_words = (n + 63) / 64;
+    memset(bitmap, 0, n_words * sizeof(unsigned long long));
+    char *values = payload + n_words * sizeof(unsigned long long);
+    int n_changed = 0;
+
+    for (int k = 0; k < n; k++) {
+        double x = full_x[export_idx[k]];
+        double diff = x - last[k];
+        if (diff > gd->tol || diff < -gd->tol) {
+            bitmap[k / 64] |= 1ULL << (k % 64);
+            if (gd->use_float) {
+                float f = (float)x;
+                memcpy(values + (long)n_changed * sizeof(float), &f, sizeof(float));
+                last[k] = (double)f;    // il ricevente vede il valore arrotondato
+            } else {
+                memcpy(values + (long)n_changed * sizeof(double), &x, sizeof(double));
+                last[k] = x;
+            }
+            n_changed++;
+        }
+    }
+
+    h.kind = gd->use_float ? GHOST_DELTA_FLOAT : GHOST_DELTA_DOUBLE;
+    h.n_values = n_changed;
+    memcpy(msg, &h, sizeof(h));
+    // Nessun valore cambiato: basta l'intestazione
+    if (n_changed == 0) return (long)sizeof(h);
+    return (long)sizeof(h) + n_words * (long)sizeof(unsigned long long) +
+           (long)n_changed * (gd->use_float ? sizeof(float) : sizeof(double));
+}
+
+static void ghost_delta_unpack(const char *msg, double *cache, int n) {
+    GhostDeltaHeader h;
+    memcpy(&h, msg, sizeof(h));
+    const char *payload = msg + sizeof(h);
+
+    if (h.kind == GHOST_DELTA_FULL) {
+        memcpy(cache, payload, (size_t)n * sizeof(double));
+        return;
+    }
+    if (h.n_values == 0) return;
+
+    const unsigned long long *bitmap = (const unsigned long long*)payload;
+    int n_words = (n + 63) / 64;
+    const char *values = payload + n_words * sizeof(unsigned long long);
+    int v = 0;
+    for (int k = 0; k < n; k++) {
+        if (bitmap[k / 64] & (1ULL << (k % 64))) {
+            if (h.kind == GHOST_DELTA_FLOAT) {
+                float f;
+                memcpy(&f, values + (long)v * sizeof(float), sizeof(float));
+                cache[k] = (double)f;
+            } else {
+                memcpy(&cache[k], values + (long)v * sizeof(double), sizeof(double));
+            }
+            v++;
+        }
+    }
+}
+
+// Messaggi di lunghezza variabile: ogni ricezione è postata con la
+// lunghezza massima e il messaggio si descrive da solo (intestazione)
+static void perform_ghost_exchange_delta(CommInfo *comm, double *full_x, int local_dim) {
+    GhostDelta *gd = comm->delta;
+    int size;
+    MPI_Comm_size(comm->mpi_comm, &size);
+    int full = (gd->exchanges % gd->refresh_every) == 0;
+    gd->exchanges++;
+
+    TRACE_BEGIN(t_pack);
+    int n_req = 0;
+    for (int p = 0; p < size; p++) {
+        if (comm->recv_counts[p] == 0) continue;
+        MPI_Irecv(gd->recv_bytes + gd->rbyte_displs[p], (int)(gd->rbyte_displs[p+1] - gd->rbyte_displs[p]),
+                  MPI_BYTE, p, GHOST_DELTA_TAG, comm->mpi_comm, &gd->reqs[n_req++]);
+    }
+
+    double sent = 0.0;
+    #pragma omp parallel for schedule(dynamic) reduction(+:sent)
+    for (int p = 0; p < size; p++) {
+        if (comm->send_counts[p] == 0) continue;
+        int off = comm->sdispls[p];
+        gd->send_len[p] = ghost_delta_pack(gd, full, full_x, comm->export_indices + off, gd->last_sent + off,
+                                           comm->send_counts[p], gd->send_bytes + gd->sbyte_displs[p]);
+        sent += gd->send_len[p];
+    }
+    TRACE_END("delta_pack", t_pack);
+
+    TRACE_BEGIN(t_exch);
+
+    for (int p = 0; p < size; p++) {
+        if (comm->send_counts[p] == 0) continue;
+        MPI_Isend(gd->send_bytes + gd->sbyte_displs[p], (int)gd->send_len[p], MPI_BYTE, p,
+                  GHOST_DELTA_TAG, comm->mpi_comm, &gd->reqs[n_req++]);
+    }
+    MPI_Waitall(n_req, gd->reqs, MPI_STATUSES_IGNORE);
+    TRACE_END("delta_exchange", t_exch);
+
+    TRACE_BEGIN(t_unpack);
+    #pragma omp parallel for schedule(dynamic)
+    for (int p = 0; p < size; p++) {
+        if (comm->recv_counts[p] == 0) continue;
+        ghost_delta_unpack(gd->recv_bytes + gd->rbyte_displs[p], gd->ghost_cache + comm->rdispls[p],
+                           comm->recv_counts[p]);
+    }
+
+    // La cache resta valida anche se il chiamante alterna i buffer di x
+    #pragma omp parallel for
+    for (int i = 0; i < comm->num_ghosts; i++) {
+        full_x[local_dim + i] = gd->ghost_cache[i];
+    }
+    TRACE_END("delta_unpack", t_unpack);
+
+    gd->bytes_sent += sent;
+    gd->bytes_plain += (double)comm->total_to_send * sizeof(double);
+}
+
 void perform_ghost_exchange(CommInfo *comm, double *full_x, int local_dim) {
+    if (comm->delta) {
+        perform_ghost_exchange_delta(comm, full_x, local_dim);
+        return;
+    }
+
+    if (comm->exchange_mode == EXCHANGE_REPLICATED) {
+        TRACE_BEGIN(t_g);
+        MPI_Allgatherv(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, full_x, comm->recv_counts, comm->rdispls,
+                       MPI_DOUBLE, comm->mpi_comm);
+        TRACE_END("allgather_x", t_g);
+        return;
+    }
+
+    // I ghost sono contigui in x, in ordine di proprietario come rdispls:
+    // si riceve direttamente in full_x + local_dim
+    if (comm->exchange_mode == EXCHANGE_DATATYPE) {
+        TRACE_BEGIN(t_w);
+        MPI_Alltoallw(full_x, comm->type_counts, comm->type_displs, comm->send_types,
+                      full_x + local_dim, comm->recv_counts, comm->rdispls_bytes, comm->recv_types,
+                      comm->mpi_comm);
+        TRACE_END("alltoallw", t_w);
+        return;
+    }
+
+    TRACE_BEGIN(t_pack);
     #pragma omp parallel for
     for (int i = 0; i < comm->total_to_send; i++) {
         comm->send_buffer[i] = full_x[comm->export_indices[i]];
     }
+    TRACE_END("pack", t_pack);
+
+    TRACE_BEGIN(t_a2a);
+    if (comm->exchange_mode == EXCHANGE_DIRECT) {
+        MPI_Alltoallv(comm->send_buffer, comm->send_counts, comm->sdispls, MPI_DOUBLE,
+                      full_x + local_dim, comm->recv_counts, comm->rdispls, MPI_DOUBLE,
+                      comm->mpi_comm);
+        TRACE_END("alltoallv", t_a2a);
+        return;
+    }
 
     MPI_Alltoallv(comm->send_buffer, comm->send_counts, comm->sdispls, MPI_DOUBLE,
                   comm->recv_buffer, comm->recv_counts, comm->rdispls, MPI_DOUBLE, 
-                  MPI_COMM_WORLD);
+                  comm->mpi_comm);
+    TRACE_END("alltoallv", t_a2a);
 
+    TRACE_BEGIN(t_unpack);
     #pragma omp parallel for
     for (int i = 0; i < comm->num_ghosts; i++) {
         full_x[local_dim + i] = comm->recv_buffer[i];
     }
+    TRACE_END("unpack", t_unpack);
 }
 
 
 
-void generate_synthetic_matrix(int rows_per_proc, int nnz_per_row, int rank, int size, LocalCSR *local_mat, int *M_glob, int *N_glob, int *nz_glob) {
+void generate_synthetic_matrix(int rows_per_proc, int nnz_per_row, MPI_Comm mpi_comm, LocalCSR *local_mat, int *M_glob, int *N_glob, long long *nz_glob) {
+    int rank, size;
+    MPI_Comm_rank(mpi_comm, &rank);
+    MPI_Comm_size(mpi_comm, &size);
     
     int i, j;
 
@@ -128,11 +462,11 @@ void generate_synthetic_matrix(int rows_per_proc, int nnz_per_row, int rank, int
 
     local_mat->n_local_rows = rows_per_proc;
     
-    int estimated_nz = rows_per_proc * (nnz_per_row + 10); 
+    spmv_nnz_t estimated_nz = (spmv_nnz_t)rows_per_proc * (nnz_per_row + 10); 
     
-    local_mat->row_ptr = (int *)malloc((rows_per_proc + 1) * sizeof(int));
-    local_mat->col_ind = (int *)malloc(estimated_nz * sizeof(int));
-    local_mat->val = (double *)malloc(estimated_nz * sizeof(double));
+    local_mat->row_ptr = (spmv_nnz_t *)malloc((rows_per_proc + 1) * sizeof(spmv_nnz_t));
+    local_mat->col_ind = (int *)malloc((size_t)estimated_nz * sizeof(int));
+    local_mat->val = (double *)malloc((size_t)estimated_nz * sizeof(double));
 
     if (!local_mat->row_ptr || !local_mat->col_ind || !local_mat->val) {
         fprintf(stderr, "Allocazione memoria fallita nel rank %d\n", rank);
@@ -141,7 +475,7 @@ void generate_synthetic_matrix(int rows_per_proc, int nnz_per_row, int rank, int
 
     srand(rank * 12345 + 789); 
     
-    int current_total_nz = 0;
+    spmv_nnz_t current_total_nz = 0;
     local_mat->row_ptr[0] = 0;
 
    
@@ -162,7 +496,7 @@ void generate_synthetic_matrix(int rows_per_proc, int nnz_per_row, int rank, int
                 is_duplicate = 0;
                 col = rand() % (*N_glob); 
                 
-                for (int k = local_mat->row_ptr[i]; k < current_total_nz; k++) {
+                for (spmv_nnz_t k = local_mat->row_ptr[i]; k < current_total_nz; k++) {
                     if (local_mat->col_ind[k] == col) {
                         is_duplicate = 1;
                         break;
@@ -176,8 +510,8 @@ void generate_synthetic_matrix(int rows_per_proc, int nnz_per_row, int rank, int
             
             if (current_total_nz >= estimated_nz) {
                 estimated_nz *= 2;
-                local_mat->col_ind = realloc(local_mat->col_ind, estimated_nz * sizeof(int));
-                local_mat->val = realloc(local_mat->val, estimated_nz * sizeof(double));
+                local_mat->col_ind = realloc(local_mat->col_ind, (size_t)estimated_nz * sizeof(int));
+                local_mat->val = realloc(local_mat->val, (size_t)estimated_nz * sizeof(double));
             }
         }
         local_mat->row_ptr[i + 1] = current_total_nz;
@@ -185,17 +519,17 @@ void generate_synthetic_matrix(int rows_per_proc, int nnz_per_row, int rank, int
     
     local_mat->n_local_nz = current_total_nz;
 
-    local_mat->col_ind = realloc(local_mat->col_ind, current_total_nz * sizeof(int));
-    local_mat->val = realloc(local_mat->val, current_total_nz * sizeof(double));
+    local_mat->col_ind = realloc(local_mat->col_ind, (size_t)current_total_nz * sizeof(int));
+    local_mat->val = realloc(local_mat->val, (size_t)current_total_nz * sizeof(double));
 
+    // Totale a 64 bit anche con indici locali a 32: la somma sui rank supera
+    // facilmente 2^31 in weak scaling
     long long loc_nz = local_mat->n_local_nz;
-    long long glob_nz_long = 0;
-    MPI_Allreduce(&loc_nz, &glob_nz_long, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
-    *nz_glob = (int)glob_nz_long;
+    MPI_Allreduce(&loc_nz, nz_glob, 1, MPI_LONG_LONG, MPI_SUM, mpi_comm);
 
     if (rank == 0) {
         printf("--- Generated Synthetic Matrix (Block Distribution) ---\n");
-        printf("Global Rows: %d, Global Cols: %d, Total NNZ: %d\n", *M_glob, *N_glob, *nz_glob);
+        printf("Global Rows: %d, Global Cols: %d, Total NNZ: %lld\n", *M_glob, *N_glob, *nz_glob);
         printf("Weak Scaling Mode: %d rows/proc, %d nnz/row (avg)\n", rows_per_proc, nnz_per_row);
         printf("-----------------------------------------------------\n");
     }
@@ -1,22 +1,100 @@
+#include <stdlib.h>
 #ifdef _OPENMP
     #include <omp.h>
 #else
     #define omp_get_thread_num() 0
     #define omp_get_num_threads() 1
+    #define omp_get_max_threads() 1
 #endif
 #include "structures.h"
 
 void compute_spmv(LocalCSR *mat, double *x, double *y) {
-    
+    if (mat->dia) {
+        dia_spmv(mat->dia, x, y, omp_get_max_threads());
+        return;
+    }
+
+    #pragma omp parallel for schedule(runtime)
+    for (int i = 0; i < mat->n_local_rows; i++) {
+        double sum = 0.0;
+        spmv_nnz_t start = mat->row_ptr[i];
+        spmv_nnz_t end = mat->row_ptr[i+1];
+
+        for (spmv_nnz_t j = start; j < end; j++) {
+            sum += mat->val[j] * x[mat->col_ind[j]];
+        }
+        y[i] = sum;
+    }
+}
+
+// Varianti fuse: y non va azzerato prima e i prodotti scalari escono dallo
+// stesso passaggio. I valori restituiti sono parziali del rank: la somma
+// globale resta a chi chiama (MPI_Allreduce)
+
+void compute_spmv_axpby(LocalCSR *mat, double alpha, double *x, double beta, double *y) {
+    if (mat->dia) {
+        // DIA sovrascrive y: beta y va applicato a parte (buffer allocato con dia)
+        double *tmp = mat->dia_tmp;
+        dia_spmv(mat->dia, x, tmp, omp_get_max_threads());
+        #pragma omp parallel for schedule(static)
+        for (int i = 0; i < mat->n_local_rows; i++) {
+            y[i] = (beta == 0.0) ? alpha * tmp[i] : alpha * tmp[i] + beta * y[i];
+        }
+        return;
+    }
+
     #pragma omp parallel for schedule(runtime)
     for (int i = 0; i < mat->n_local_rows; i++) {
         double sum = 0.0;
-        int start = mat->row_ptr[i];
-        int end = mat->row_ptr[i+1];
+        for (spmv_nnz_t j = mat->row_ptr[i]; j < mat->row_ptr[i+1]; j++) {
+            sum += mat->val[j] * x[mat->col_ind[j]];
+        }
+        y[i] = (beta == 0.0) ? alpha * sum : alpha * sum + beta * y[i];
+    }
+}
+
+// Con la distribuzione ciclica la riga locale i e l'elemento locale x[i]
+// corrispondono allo stesso indice globale (matrice quadrata)
+double compute_spmv_xdot(LocalCSR *mat, double *x, double *y) {
+    double dot = 0.0;
+
+    if (mat->dia) {
+        dia_spmv(mat->dia, x, y, omp_get_max_threads());
+        #pragma omp parallel for schedule(static) reduction(+:dot)
+        for (int i = 0; i < mat->n_local_rows; i++) dot += x[i] * y[i];
+        return dot;
+    }
+
+    #pragma omp parallel for schedule(runtime) reduction(+:dot)
+    for (int i = 0; i < mat->n_local_rows; i++) {
+        double sum = 0.0;
+        for (spmv_nnz_t j = mat->row_ptr[i]; j < mat->row_ptr[i+1]; j++) {
+            sum += mat->val[j] * x[mat->col_ind[j]];
+        }
+        y[i] = sum;
+        dot += x[i] * sum;
+    }
+    return dot;
+}
+
+double compute_spmv_norm2(LocalCSR *mat, double *x, double *y) {
+    double norm2 = 0.0;
 
-        for (int j = start; j < end; j++) {
+    if (mat->dia) {
+        dia_spmv(mat->dia, x, y, omp_get_max_threads());
+        #pragma omp parallel for schedule(static) reduction(+:norm2)
+        for (int i = 0; i < mat->n_local_rows; i++) norm2 += y[i] * y[i];
+        return norm2;
+    }
+
+    #pragma omp parallel for schedule(runtime) reduction(+:norm2)
+    for (int i = 0; i < mat->n_local_rows; i++) {
+        double sum = 0.0;
+        for (spmv_nnz_t j = mat->row_ptr[i]; j < mat->row_ptr[i+1]; j++) {
             sum += mat->val[j] * x[mat->col_ind[j]];
         }
         y[i] = sum;
+        norm2 += sum * sum;
     }
+    return norm2;
 }
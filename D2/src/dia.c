@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "dia.h"
+
+// Indice della diagonale con offset off (offset crescenti), -1 se assente
+static int dia_find(const int *offsets, int n_diags, int off) {
+    int lo = 0, hi = n_diags - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (offsets[mid] == off) return mid;
+        if (offsets[mid] < off) lo = mid + 1; else hi = mid - 1;
+    }
+    return -1;
+}
+
+DiaMatrix* dia_build(int n_rows, int n_cols, const int *row_ptr, const int *col,
+                     const double *val) {
+    int nz = row_ptr[n_rows];
+    if (n_rows <= 0 || n_cols <= 0 || nz == 0) return NULL;
+
+    // Istogramma degli offset colonna - riga, spostati di n_rows - 1
+    long n_offsets = (long)n_rows + n_cols - 1;
+    int *count = (int*)calloc(n_offsets, sizeof(int));
+    for (int i = 0; i < n_rows; i++) {
+        for (int k = row_ptr[i]; k < row_ptr[i + 1]; k++) {
+            count[col[k] - i + n_rows - 1]++;
+        }
+    }
+
+    // Diagonali abbastanza piene, le più popolate per prime
+    int offsets[DIA_MAX_DIAGS];
+    int n_diags = 0;
+    long covered = 0;
+    while (n_diags < DIA_MAX_DIAGS) {
+        long best = -1;
+        for (long o = 0; o < n_offsets; o++) {
+            if (count[o] > 0 && (best < 0 || count[o] > count[best])) best = o;
+        }
+        if (best < 0) break;
+
+        int off = (int)(best - (n_rows - 1));
+        int lo = off < 0 ? -off : 0;
+        int hi = n_cols - off < n_rows ? n_cols - off : n_rows;
+        if (count[best] < DIA_MIN_FILL * (hi - lo)) break;
+
+        offsets[n_diags++] = off;
+        covered += count[best];
+        count[best] = 0;
+    }
+    free(count);
+
+    if (n_diags == 0 || covered < DIA_MIN_COVER * nz) return NULL;
+
+    // Offset crescenti: le diagonali si leggono in ordine di memoria di x
+    for (int a = 1; a < n_diags; a++) {
+        int v = offsets[a], b = a - 1;
+        while (b >= 0 && offsets[b] > v) { offsets[b + 1] = offsets[b]; b--; }
+        offsets[b + 1] = v;
+    }
+
+    DiaMatrix *d = (DiaMatrix*)malloc(sizeof(DiaMatrix));
+    d->n_rows = n_rows;
+    d->n_cols = n_cols;
+    d->nz = nz;
+    d->n_diags = n_diags;
+    d->offsets = (int*)malloc(n_diags * sizeof(int));
+    for (int k = 0; k < n_diags; k++) d->offsets[k] = offsets[k];
+    d->data = (double*)calloc((long)n_diags * n_rows, sizeof(double));
+    d->rest_ptr = (int*)calloc(n_rows + 1, sizeof(int));
+
+    // Primo passaggio: elementi sulle diagonali scelte, conteggio del resto
+    for (int i = 0; i < n_rows; i++) {
+        for (int k = row_ptr[i]; k < row_ptr[i + 1]; k++) {
+            int found = dia_find(d->offsets, n_diags, col[k] - i);
+            if (found >= 0) d->data[(long)found * n_rows + i] += val[k];
+            else d->rest_ptr[i + 1]++;
+        }
+    }
+    for (int i = 0; i < n_rows; i++) d->rest_ptr[i + 1] += d->rest_ptr[i];
+
+    d->rest_nz = d->rest_ptr[n_rows];
+    d->rest_col = (int*)malloc((d->rest_nz > 0 ? d->rest_nz : 1) * sizeof(int));
+    d->rest_val = (double*)malloc((d->rest_nz > 0 ? d->rest_nz : 1) * sizeof(double));
+
+    // Secondo passaggio: gli elementi rimasti vanno nel CSR
+    for (int i = 0; i < n_rows; i++) {
+        int pos = d->rest_ptr[i];
+        for (int k = row_ptr[i]; k < row_ptr[i + 1]; k++) {
+            if (dia_find(d->offsets, n_diags, col[k] - i) < 0) {
+                d->rest_col[pos] = col[k];
+                d->rest_val[pos] = val[k];
+                pos++;
+            }
+        }
+    }
+
+    d->fill = (double)covered / ((double)n_diags * n_rows);
+    d->coverage = (double)covered / nz;
+
+    return d;
+}
+
+void dia_spmv(const DiaMatrix *d, const double *x, double *y, int num_threads) {
+    const int n_rows = d->n_rows;
+    const int n_cols = d->n_cols;
+
+    // Blocchi di righe: per ogni blocco le diagonali sono flussi contigui
+    // senza indici, il ciclo interno è vettorizzabile
+    #pragma omp parallel for num_threads(num_threads) schedule(static)
+    for (int b = 0; b < n_rows; b += DIA_BLOCK_ROWS) {
+        int end = b + DIA_BLOCK_ROWS < n_rows ? b + DIA_BLOCK_ROWS : n_rows;
+        double *restrict yb = y;
+
+        for (int i = b; i < end; i++) yb[i] = 0.0;
+
+        for (int q = 0; q < d->n_diags; q++) {
+            const int off = d->offsets[q];
+            const double *restrict dq = d->data + (long)q * n_rows;
+            int lo = b > -off ? b : -off;
+            int hi = end < n_cols - off ? end : n_cols - off;
+
+            #pragma omp simd
+            for (int i = lo; i < hi; i++) {
+                yb[i] += dq[i] * x[i + off];
+            }
+        }
+
+        for (int i = b; i < end; i++) {
+            double sum = 0.0;
+            for (int k = d->rest_ptr[i]; k < d->rest_ptr[i + 1]; k++) {
+                sum += d->rest_val[k] * x[d->rest_col[k]];
+            }
+            yb[i] += sum;
+        }
+    }
+}
+
+void free_dia(DiaMatrix *d) {
+    if (d) {
+        free(d->offsets);
+        free(d->data);
+        free(d->rest_ptr);
+        free(d->rest_col);
+        free(d->rest_val);
+        free(d);
+    }
+}
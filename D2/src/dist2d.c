@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <mpi.h>
+#include "dist2d.h"
+#include "alloc.h"
+#include "trace.h"
+
+void compute_spmv(LocalCSR *m, double *x, double *y);
+
+Grid2D* grid2d_create(MPI_Comm mpi_comm) {
+    int rank, size;
+    MPI_Comm_rank(mpi_comm, &rank);
+    MPI_Comm_size(mpi_comm, &size);
+
+    Grid2D *g = calloc(1, sizeof(Grid2D));
+    int dims[2] = {0, 0};
+    MPI_Dims_create(size, 2, dims);
+    g->pr = dims[0];
+    g->pc = dims[1];
+    g->my_row = rank / g->pc;
+    g->my_col = rank % g->pc;
+
+    // Ordinamento nei sotto-comunicatori = coordinata, come i pezzi di x e y
+    MPI_Comm_split(mpi_comm, g->my_row, g->my_col, &g->row_comm);
+    MPI_Comm_split(mpi_comm, g->my_col, g->my_row, &g->col_comm);
+    return g;
+}
+
+int grid2d_block_start(int n, int k, int b) {
+    return (int)((long)n * b / k);
+}
+
+int grid2d_block_of(int n, int k, int idx) {
+    int b = (int)((long)idx * k / n);
+    while (b + 1 < k && grid2d_block_start(n, k, b + 1) <= idx) b++;
+    while (b > 0 && grid2d_block_start(n, k, b) > idx) b--;
+    return b;
+}
+
+int grid2d_owner(const Grid2D *g, int M, int N, int i, int j) {
+    return grid2d_block_of(M, g->pr, i) * g->pc + grid2d_block_of(N, g->pc, j);
+}
+
+void grid2d_set_size(Grid2D *g, int M, int N) {
+    g->row_begin = grid2d_block_start(M, g->pr, g->my_row);
+    g->row_end = grid2d_block_start(M, g->pr, g->my_row + 1);
+    g->col_begin = grid2d_block_start(N, g->pc, g->my_col);
+    g->col_end = grid2d_block_start(N, g->pc, g->my_col + 1);
+
+    // x_j diviso tra i pr rank della colonna, y_i tra i pc rank della riga
+    int n_x = g->col_end - g->col_begin, n_y = g->row_end - g->row_begin;
+    g->x_counts = malloc(g->pr * sizeof(int));
+    g->x_displs = malloc(g->pr * sizeof(int));
+    for (int q = 0; q < g->pr; q++) {
+        g->x_displs[q] = grid2d_block_start(n_x, g->pr, q);
+        g->x_counts[q] = grid2d_block_start(n_x, g->pr, q + 1) - g->x_displs[q];
+    }
+    g->y_counts = malloc(g->pc * sizeof(int));
+    for (int q = 0; q < g->pc; q++) {
+        g->y_counts[q] = grid2d_block_start(n_y, g->pc, q + 1) - grid2d_block_start(n_y, g->pc, q);
+    }
+    g->x_piece = g->x_counts[g->my_row];
+    g->y_piece = g->y_counts[g->my_col];
+
+    g->x_block = alloc_zeroed(n_x > 0 ? n_x : 1, sizeof(double));
+    g->y_partial = alloc_zeroed(n_y > 0 ? n_y : 1, sizeof(double));
+}
+
+void grid2d_spmv(Grid2D *g, LocalCSR *mat, double *x_piece, double *y_piece, double *comm_time) {
+    double t0 = MPI_Wtime();
+    TRACE_BEGIN(t_x);
+    MPI_Allgatherv(x_piece, g->x_piece, MPI_DOUBLE, g->x_block, g->x_counts, g->x_displs,
+                   MPI_DOUBLE, g->col_comm);
+    TRACE_END("allgather_x", t_x);
+    double t1 = MPI_Wtime();
+
+    TRACE_BEGIN(t_c);
+    compute_spmv(mat, g->x_block, g->y_partial);
+    TRACE_END("compute", t_c);
+    double t2 = MPI_Wtime();
+
+    TRACE_BEGIN(t_y);
+    MPI_Reduce_scatter(g->y_partial, y_piece, g->y_counts, MPI_DOUBLE, MPI_SUM, g->row_comm);
+    TRACE_END("reduce_scatter_y", t_y);
+    *comm_time = (t1 - t0) + (MPI_Wtime() - t2);
+}
+
+void free_grid2d(Grid2D *g) {
+    if (g) {
+        MPI_Comm_free(&g->row_comm);
+        MPI_Comm_free(&g->col_comm);
+        free(g->x_counts);
+        free(g->x_displs);
+        free(g->y_counts);
+        free(g->x_block);
+        free(g->y_partial);
+        free(g);
+    }
+}
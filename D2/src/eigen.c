@@ -0,0 +1,132 @@
+#include <stdlib.h>
+#include <math.h>
+#include <mpi.h>
+#include "eigen.h"
+#include "tridiag.h"
+#include "alloc.h"
+
+void compute_spmv_axpby(LocalCSR *m, double alpha, double *x, double beta, double *y);
+double compute_spmv_norm2(LocalCSR *m, double *x, double *y);
+
+EigenState* eigen_create(LocalCSR *mat, MPI_Comm mpi_comm, int x_dim, int mode, int max_steps) {
+    EigenState *es = calloc(1, sizeof(EigenState));
+    es->mode = mode;
+    es->mpi_comm = mpi_comm;
+    es->n_local = mat->n_local_rows;
+    es->max_steps = max_steps;
+    es->v = alloc_zeroed(x_dim, sizeof(double));
+    es->w = alloc_zeroed(x_dim, sizeof(double));
+
+    // Vettore iniziale dipendente dall'indice globale della riga, quindi
+    // identico per ogni numero di processi e uguale a quello di D1
+    int rank, size;
+    MPI_Comm_rank(mpi_comm, &rank);
+    MPI_Comm_size(mpi_comm, &size);
+    double part = 0.0, norm2 = 0.0;
+    for (int i = 0; i < es->n_local; i++) {
+        long g = partition_global(mat->part, i, rank, size);
+        es->v[i] = 1.0 + (g % 7) * 0.1;
+        part += es->v[i] * es->v[i];
+    }
+    MPI_Allreduce(&part, &norm2, 1, MPI_DOUBLE, MPI_SUM, mpi_comm);
+    double inv = 1.0 / sqrt(norm2);
+    for (int i = 0; i < es->n_local; i++) es->v[i] *= inv;
+
+    if (mode == EIGEN_LANCZOS) {
+        es->alpha = malloc(max_steps * sizeof(double));
+        es->beta = malloc(max_steps * sizeof(double));
+    }
+    return es;
+}
+
+static void power_step(EigenState *es, LocalCSR *mat) {
+    // w = A v e ||w||^2 locale nello stesso passaggio, poi v^T w: una sola
+    // riduzione globale per i due valori
+    double part[2], tot[2];
+    part[0] = compute_spmv_norm2(mat, es->v, es->w);
+    double dot = 0.0;
+    #pragma omp parallel for schedule(static) reduction(+:dot)
+    for (int i = 0; i < es->n_local; i++) dot += es->v[i] * es->w[i];
+    part[1] = dot;
+    MPI_Allreduce(part, tot, 2, MPI_DOUBLE, MPI_SUM, es->mpi_comm);
+
+    double inv = tot[0] > 0.0 ? 1.0 / sqrt(tot[0]) : 0.0;
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < es->n_local; i++) es->w[i] *= inv;
+    es->lambda = tot[1];
+
+    double *tmp = es->v;
+    es->v = es->w;
+    es->w = tmp;
+}
+
+static void lanczos_step(EigenState *es, LocalCSR *mat) {
+    if (es->breakdown || es->steps >= es->max_steps) return;
+    int j = es->steps;
+
+    // w = A v - beta_{j-1} v_{j-1}: w contiene già v_{j-1}
+    compute_spmv_axpby(mat, 1.0, es->v, -es->beta_prev, es->w);
+
+    double part = 0.0, alpha = 0.0;
+    #pragma omp parallel for schedule(static) reduction(+:part)
+    for (int i = 0; i < es->n_local; i++) part += es->w[i] * es->v[i];
+    MPI_Allreduce(&part, &alpha, 1, MPI_DOUBLE, MPI_SUM, es->mpi_comm);
+
+    double part2 = 0.0, norm2 = 0.0;
+    #pragma omp parallel for schedule(static) reduction(+:part2)
+    for (int i = 0; i < es->n_local; i++) {
+        es->w[i] -= alpha * es->v[i];
+        part2 += es->w[i] * es->w[i];
+    }
+    MPI_Allreduce(&part2, &norm2, 1, MPI_DOUBLE, MPI_SUM, es->mpi_comm);
+    double beta = sqrt(norm2);
+
+    // alpha e beta sono globali: tutti i rank prendono la stessa decisione
+    es->alpha[j] = alpha;
+    es->beta[j] = beta;
+    es->steps++;
+    if (beta < 1e-12 * fabs(alpha) || beta == 0.0) {
+        es->breakdown = 1;
+        return;
+    }
+
+    double inv = 1.0 / beta;
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < es->n_local; i++) es->w[i] *= inv;
+
+    double *tmp = es->v;
+    es->v = es->w;
+    es->w = tmp;
+    es->beta_prev = beta;
+}
+
+void eigen_step(EigenState *es, LocalCSR *mat) {
+    if (es->mode == EIGEN_POWER) {
+        power_step(es, mat);
+        es->steps++;
+    } else {
+        lanczos_step(es, mat);
+    }
+}
+
+void eigen_estimate(EigenState *es, double *lambda_min, double *lambda_max) {
+    if (es->mode == EIGEN_POWER) {
+        *lambda_min = *lambda_max = es->lambda;
+    } else {
+        tridiag_extreme_eigenvalues(es->alpha, es->beta, es->steps, lambda_min, lambda_max);
+    }
+}
+
+const char* eigen_mode_name(int mode) {
+    return mode == EIGEN_POWER ? "power" : mode == EIGEN_LANCZOS ? "lanczos" : "none";
+}
+
+void free_eigen_state(EigenState *es) {
+    if (es) {
+        free(es->v);
+        free(es->w);
+        free(es->alpha);
+        free(es->beta);
+        free(es);
+    }
+}
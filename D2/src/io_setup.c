@@ -3,15 +3,56 @@
 #include <string.h>
 #include "structures.h"
 #include "matrix_io.h" 
+#include "alloc.h"
+#include "trace.h"
+#include "dist2d.h"
 
-void convert_coo_to_csr(int *I, int *J, double *V, int nz, int rows, LocalCSR *dest);
+void convert_coo_to_csr(int *I, int *J, double *V, spmv_nnz_t nz, int rows, LocalCSR *dest);
+
+// Proprietario di un nonzero: riga ciclica (GET_OWNER) o blocco della griglia 2D
+static int entry_owner(const Grid2D *grid, int M, int N, int i, int j, int size) {
+    return grid ? grid2d_owner(grid, M, N, i, j) : GET_OWNER(i, size);
+}
+
+// Indici locali: riga ciclica e colonna globale (rimappata poi dallo schema
+// dei ghost), oppure riga e colonna relative al blocco 2D
+static void localize_entries(const Grid2D *grid, int *I, int *J, spmv_nnz_t nz, int size) {
+    for (spmv_nnz_t i = 0; i < nz; i++) {
+        if (grid) {
+            I[i] -= grid->row_begin;
+            J[i] -= grid->col_begin;
+        } else {
+            I[i] = GET_LOCAL_IDX(I[i], size);
+        }
+    }
+}
+
+// Invio e ricezione di count elementi anche oltre INT_MAX (tipo derivato)
+static void send_large(const void *buf, spmv_nnz_t count, MPI_Datatype base, int dest, int tag, MPI_Comm mpi_comm) {
+    int n;
+    MPI_Datatype t = large_count_type(count, base, &n);
+    MPI_Send(buf, n, t, dest, tag, mpi_comm);
+    free_large_count_type(t, base);
+}
+
+static void recv_large(void *buf, spmv_nnz_t count, MPI_Datatype base, int src, int tag, MPI_Comm mpi_comm) {
+    int n;
+    MPI_Datatype t = large_count_type(count, base, &n);
+    MPI_Recv(buf, n, t, src, tag, mpi_comm, MPI_STATUS_IGNORE);
+    free_large_count_type(t, base);
+}
+
+void load_and_scatter_matrix(const char *filename, MPI_Comm mpi_comm, Grid2D *grid,
+                             LocalCSR *local_mat, int *M_glob, int *N_glob, long long *nz_glob) {
+    int rank, size;
+    MPI_Comm_rank(mpi_comm, &rank);
+    MPI_Comm_size(mpi_comm, &size);
 
-void load_and_scatter_matrix(const char *filename, int rank, int size, 
-                             LocalCSR *local_mat, int *M_glob, int *N_glob, int *nz_glob) {
-    
     if (rank == 0) {
         printf("Rank 0: Reading matrix %s...\n", filename);
+        TRACE_BEGIN(t_read);
         Matrix *mat = read_matrix(filename);
+        TRACE_END("read_matrix", t_read);
         if (!mat) {
             fprintf(stderr, "Error reading matrix\n");
             MPI_Abort(MPI_COMM_WORLD, 1);
@@ -21,46 +62,48 @@ void load_and_scatter_matrix(const char *filename, int rank, int size,
         *N_glob = mat->N;
         *nz_glob = mat->nz;
 
-        MPI_Bcast(M_glob, 1, MPI_INT, 0, MPI_COMM_WORLD);
-        MPI_Bcast(N_glob, 1, MPI_INT, 0, MPI_COMM_WORLD);
+        MPI_Bcast(M_glob, 1, MPI_INT, 0, mpi_comm);
+        MPI_Bcast(N_glob, 1, MPI_INT, 0, mpi_comm);
+        if (grid) grid2d_set_size(grid, *M_glob, *N_glob);
 
-        int *counts = (int*)calloc(size, sizeof(int));
-        for (int i = 0; i < mat->nz; i++) {
-            counts[GET_OWNER(mat->I[i], size)]++;
+        TRACE_BEGIN(t_scatter);
+        spmv_nnz_t *counts = (spmv_nnz_t*)calloc(size, sizeof(spmv_nnz_t));
+        for (spmv_nnz_t i = 0; i < mat->nz; i++) {
+            counts[entry_owner(grid, *M_glob, *N_glob, mat->I[i], mat->J[i], size)]++;
         }
 
         for (int p = 1; p < size; p++) {
-            int p_nz = counts[p];
-            MPI_Send(&p_nz, 1, MPI_INT, p, 0, MPI_COMM_WORLD);
+            spmv_nnz_t p_nz = counts[p];
+            MPI_Send(&p_nz, 1, MPI_SPMV_NNZ, p, 0, mpi_comm);
 
-            int *buf_I = malloc(p_nz * sizeof(int));
-            int *buf_J = malloc(p_nz * sizeof(int));
-            double *buf_V = malloc(p_nz * sizeof(double));
+            int *buf_I = malloc((size_t)p_nz * sizeof(int));
+            int *buf_J = malloc((size_t)p_nz * sizeof(int));
+            double *buf_V = malloc((size_t)p_nz * sizeof(double));
             
-            int curr = 0;
-            for(int k=0; k < mat->nz; k++) {
-                if (GET_OWNER(mat->I[k], size) == p) {
+            spmv_nnz_t curr = 0;
+            for(spmv_nnz_t k=0; k < mat->nz; k++) {
+                if (entry_owner(grid, *M_glob, *N_glob, mat->I[k], mat->J[k], size) == p) {
                     buf_I[curr] = mat->I[k];
                     buf_J[curr] = mat->J[k];
                     buf_V[curr] = mat->val[k];
                     curr++;
                 }
             }
-            MPI_Send(buf_I, p_nz, MPI_INT, p, 1, MPI_COMM_WORLD);
-            MPI_Send(buf_J, p_nz, MPI_INT, p, 2, MPI_COMM_WORLD);
-            MPI_Send(buf_V, p_nz, MPI_DOUBLE, p, 3, MPI_COMM_WORLD);
+            send_large(buf_I, p_nz, MPI_INT, p, 1, mpi_comm);
+            send_large(buf_J, p_nz, MPI_INT, p, 2, mpi_comm);
+            send_large(buf_V, p_nz, MPI_DOUBLE, p, 3, mpi_comm);
             
             free(buf_I); free(buf_J); free(buf_V);
         }
 
-        int my_nz = counts[0];
-        int *my_I = malloc(my_nz * sizeof(int));
-        int *my_J = malloc(my_nz * sizeof(int));
-        double *my_V = malloc(my_nz * sizeof(double));
+        spmv_nnz_t my_nz = counts[0];
+        int *my_I = malloc((size_t)my_nz * sizeof(int));
+        int *my_J = malloc((size_t)my_nz * sizeof(int));
+        double *my_V = malloc((size_t)my_nz * sizeof(double));
         
-        int k = 0;
-        for (int i = 0; i < mat->nz; i++) {
-            if (GET_OWNER(mat->I[i], size) == 0) {
+        spmv_nnz_t k = 0;
+        for (spmv_nnz_t i = 0; i < mat->nz; i++) {
+            if (entry_owner(grid, *M_glob, *N_glob, mat->I[i], mat->J[i], size) == 0) {
                 my_I[k] = mat->I[i];
                 my_J[k] = mat->J[i];
                 my_V[k] = mat->val[i];
@@ -69,58 +112,63 @@ void load_and_scatter_matrix(const char *filename, int rank, int size,
         }
         free(counts);
         free_matrix(mat);
+        TRACE_END("scatter", t_scatter);
 
-        int my_rows = (*M_glob + size - 1 - rank) / size;
-        for(int i=0; i<my_nz; i++) my_I[i] = GET_LOCAL_IDX(my_I[i], size);
+        int my_rows = grid ? grid->row_end - grid->row_begin : (*M_glob + size - 1 - rank) / size;
+        localize_entries(grid, my_I, my_J, my_nz, size);
         
+        TRACE_BEGIN(t_csr);
         convert_coo_to_csr(my_I, my_J, my_V, my_nz, my_rows, local_mat);
+        TRACE_END("coo_to_csr", t_csr);
         free(my_I); free(my_J); free(my_V);
 
     } else {
 
-        MPI_Bcast(M_glob, 1, MPI_INT, 0, MPI_COMM_WORLD);
-        MPI_Bcast(N_glob, 1, MPI_INT, 0, MPI_COMM_WORLD);
-
-        int my_nz;
-        MPI_Recv(&my_nz, 1, MPI_INT, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        MPI_Bcast(M_glob, 1, MPI_INT, 0, mpi_comm);
+        MPI_Bcast(N_glob, 1, MPI_INT, 0, mpi_comm);
+        if (grid) grid2d_set_size(grid, *M_glob, *N_glob);
 
-        int *l_I = malloc(my_nz * sizeof(int));
-        int *l_J = malloc(my_nz * sizeof(int));
-        double *l_V = malloc(my_nz * sizeof(double));
+        TRACE_BEGIN(t_scatter);
+        spmv_nnz_t my_nz;
+        MPI_Recv(&my_nz, 1, MPI_SPMV_NNZ, 0, 0, mpi_comm, MPI_STATUS_IGNORE);
 
-        MPI_Recv(l_I, my_nz, MPI_INT, 0, 1, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-        MPI_Recv(l_J, my_nz, MPI_INT, 0, 2, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-        MPI_Recv(l_V, my_nz, MPI_DOUBLE, 0, 3, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        int *l_I = malloc((size_t)my_nz * sizeof(int));
+        int *l_J = malloc((size_t)my_nz * sizeof(int));
+        double *l_V = malloc((size_t)my_nz * sizeof(double));
 
-        int my_rows = (*M_glob + size - 1 - rank) / size;
-        if ((*M_glob % size != 0) && (rank >= *M_glob % size)) my_rows = *M_glob/size;
-        else my_rows = *M_glob/size + 1;
+        recv_large(l_I, my_nz, MPI_INT, 0, 1, mpi_comm);
+        recv_large(l_J, my_nz, MPI_INT, 0, 2, mpi_comm);
+        recv_large(l_V, my_nz, MPI_DOUBLE, 0, 3, mpi_comm);
+        TRACE_END("scatter", t_scatter);
 
-        for(int i=0; i<my_nz; i++) l_I[i] = GET_LOCAL_IDX(l_I[i], size);
+        int my_rows = grid ? grid->row_end - grid->row_begin : (*M_glob + size - 1 - rank) / size;
+        localize_entries(grid, l_I, l_J, my_nz, size);
 
+        TRACE_BEGIN(t_csr);
         convert_coo_to_csr(l_I, l_J, l_V, my_nz, my_rows, local_mat);
+        TRACE_END("coo_to_csr", t_csr);
         free(l_I); free(l_J); free(l_V);
     }
 }
 
-void convert_coo_to_csr(int *I, int *J, double *V, int nz, int rows, LocalCSR *dest) {
+void convert_coo_to_csr(int *I, int *J, double *V, spmv_nnz_t nz, int rows, LocalCSR *dest) {
     dest->n_local_rows = rows;
     dest->n_local_nz = nz;
-    dest->row_ptr = calloc(rows + 1, sizeof(int));
+    dest->row_ptr = alloc_zeroed(rows + 1, sizeof(spmv_nnz_t));
     
-    for (int i = 0; i < nz; i++) dest->row_ptr[I[i] + 1]++;
+    for (spmv_nnz_t i = 0; i < nz; i++) dest->row_ptr[I[i] + 1]++;
     
     for (int i = 0; i < rows; i++) dest->row_ptr[i+1] += dest->row_ptr[i];
     
-    dest->col_ind = malloc(nz * sizeof(int));
-    dest->val = malloc(nz * sizeof(double));
+    dest->col_ind = alloc_array((size_t)nz * sizeof(int));
+    dest->val = alloc_array((size_t)nz * sizeof(double));
     
-    int *temp_ptr = malloc(rows * sizeof(int));
-    memcpy(temp_ptr, dest->row_ptr, rows * sizeof(int));
+    spmv_nnz_t *temp_ptr = malloc(rows * sizeof(spmv_nnz_t));
+    memcpy(temp_ptr, dest->row_ptr, rows * sizeof(spmv_nnz_t));
     
-    for (int i = 0; i < nz; i++) {
+    for (spmv_nnz_t i = 0; i < nz; i++) {
         int row = I[i];
-        int idx = temp_ptr[row]++;
+        spmv_nnz_t idx = temp_ptr[row]++;
         dest->col_ind[idx] = J[i];
         dest->val[idx] = V[i];
     }
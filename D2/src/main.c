@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <time.h>
 #include <mpi.h>
 #ifdef _OPENMP
@@ -8,48 +9,356 @@
 #else
     #define omp_get_thread_num() 0
     #define omp_get_num_threads() 1
+    #define omp_get_max_threads() 1
 #endif
 #include "structures.h"
+#include "bench.h"
+#include "alloc.h"
+#include "eigen.h"
+#include "trace.h"
+#include "report.h"
+#include "repartition.h"
+#include "dist2d.h"
+#include "snapshot.h"
 
-void load_and_scatter_matrix(const char *f, int r, int s, LocalCSR *m, int *Mg, int *Ng, int *nz);
-void setup_communication_pattern(LocalCSR *m, CommInfo *c, int r, int s, int Ng);
+void load_and_scatter_matrix(const char *f, MPI_Comm mc, Grid2D *g, LocalCSR *m, int *Mg, int *Ng, long long *nz);
+void setup_communication_pattern(LocalCSR *m, CommInfo *c, MPI_Comm mc, int Ng);
+void setup_replicated_x(LocalCSR *m, CommInfo *c, MPI_Comm mc, int Ng);
 void perform_ghost_exchange(CommInfo *c, double *x, int dim);
+void setup_ghost_delta(CommInfo *c, double tol, int use_float, int refresh_every);
+void setup_exchange(CommInfo *c, int mode);
+const char* exchange_mode_name(int mode);
+OverlapPlan* overlap_create(LocalCSR *m, CommInfo *c, int x_dim, int mode);
+double overlap_spmv(OverlapPlan *op, LocalCSR *m, CommInfo *c, double *x, double *y, int x_dim);
+const char* overlap_mode_name(int mode);
+void free_overlap_plan(OverlapPlan *op);
 void compute_spmv(LocalCSR *m, double *x, double *y);
+void compute_spmv_axpby(LocalCSR *m, double alpha, double *x, double beta, double *y);
+double compute_spmv_xdot(LocalCSR *m, double *x, double *y);
+double compute_spmv_norm2(LocalCSR *m, double *x, double *y);
 
-void generate_synthetic_matrix(int rows_per_proc, int nnz_per_row, int rank, int size, LocalCSR *local_mat, int *M_glob, int *N_glob, int *nz_glob);
+void generate_synthetic_matrix(int rows_per_proc, int nnz_per_row, MPI_Comm mc, LocalCSR *local_mat, int *M_glob, int *N_glob, long long *nz_glob);
 
-int compare_doubles(const void *a, const void *b) {
-    double arg1 = *(const double *)a;
-    double arg2 = *(const double *)b;
-    if (arg1 < arg2) return -1;
-    if (arg1 > arg2) return 1;
-    return 0;
+// --fused: kernel locale fuso con l'operazione vettoriale successiva
+#define FUSED_NONE   0
+#define FUSED_AXPBY  1   // y = FUSED_ALPHA A x + FUSED_BETA y
+#define FUSED_XDOT   2   // y = A x e x^T A x
+#define FUSED_NORM2  3   // y = A x e ||y||^2
+#define FUSED_ALPHA  1.0
+#define FUSED_BETA   0.5
+
+// --exchange=compare: scambi misurati per ogni variante prima del benchmark
+#define EXCHANGE_COMPARE      -1
+#define EXCHANGE_COMPARE_REPS 100
+
+// --replicate-x
+#define REPLICATE_OFF   0
+#define REPLICATE_ON    1
+#define REPLICATE_AUTO  2
+
+// Passo di calcolo: per xdot/norm2 la somma globale dei parziali fa parte
+// del passo, come in un solutore che ne ha bisogno subito
+static double local_step(int fused, MPI_Comm mc, LocalCSR *m, double *x, double *y) {
+    double part = 0.0, total = 0.0;
+    switch (fused) {
+        case FUSED_AXPBY:
+            compute_spmv_axpby(m, FUSED_ALPHA, x, FUSED_BETA, y);
+            return 0.0;
+        case FUSED_XDOT:
+            part = compute_spmv_xdot(m, x, y);
+            break;
+        case FUSED_NORM2:
+            part = compute_spmv_norm2(m, x, y);
+            break;
+        default:
+            compute_spmv(m, x, y);
+            return 0.0;
+    }
+    MPI_Allreduce(&part, &total, 1, MPI_DOUBLE, MPI_SUM, mc);
+    return total;
+}
+
+// x replicato: forzato, oppure automatico sotto la soglia di dimensione
+static int use_replicated_x(int replicate, int size, int N_glob) {
+    return replicate == REPLICATE_ON || (replicate == REPLICATE_AUTO && size > 1 && N_glob <= REPLICATE_AUTO_MAX_N);
+}
+
+// dia_build (condiviso con D1) vuole row_ptr int: con -DSPMV_INDEX64 copia
+// temporanea, e niente DIA se i nonzeri locali non ci stanno
+static DiaMatrix* build_dia(const LocalCSR *mat, int n_cols) {
+#ifdef SPMV_INDEX64
+    if (mat->n_local_nz > INT_MAX) return NULL;
+    int *row_ptr = malloc((mat->n_local_rows + 1) * sizeof(int));
+    for (int i = 0; i <= mat->n_local_rows; i++) row_ptr[i] = (int)mat->row_ptr[i];
+    DiaMatrix *d = dia_build(mat->n_local_rows, n_cols, row_ptr, mat->col_ind, mat->val);
+    free(row_ptr);
+    return d;
+#else
+    return dia_build(mat->n_local_rows, n_cols, mat->row_ptr, mat->col_ind, mat->val);
+#endif
+}
+
+// Errore di un gruppo reso comune a tutto il job: con --ensemble i gruppi
+// possono avere matrici diverse, e un gruppo che uscisse da solo lascerebbe
+// gli altri fermi nelle collettive su MPI_COMM_WORLD (report, traccia)
+static int job_error(int failed) {
+    int any = 0;
+    MPI_Allreduce(&failed, &any, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+    return any;
+}
+
+// --ensemble-list: matrice del gruppo = riga (group % righe) del file
+static int ensemble_matrix(const char *list, int group, char *path, int len) {
+    FILE *f = fopen(list, "r");
+    if (!f) return 0;
+    char line[1024];
+    int n = 0;
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] != '\0') n++;
+    }
+    if (n == 0) {
+        fclose(f);
+        return 0;
+    }
+    rewind(f);
+    int k = 0, target = group % n;
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0') continue;
+        if (k++ == target) {
+            snprintf(path, len, "%s", line);
+            break;
+        }
+    }
+    fclose(f);
+    return 1;
 }
 
 int main(int argc, char *argv[]) {
     int provided, rank, size;
 
-    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    // Il livello di thread va chiesto prima di MPI_Init: --overlap fa
+    // comunicare anche thread diversi dal master
+    int required = MPI_THREAD_FUNNELED;
+    for (int a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "--overlap") == 0 || strcmp(argv[a], "--overlap=task") == 0) required = MPI_THREAD_SERIALIZED;
+        else if (strcmp(argv[a], "--overlap=p2p") == 0) required = MPI_THREAD_MULTIPLE;
+    }
+
+    MPI_Init_thread(&argc, &argv, required, &provided);
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &size);
 
+    // Le opzioni --xxx possono stare in qualunque posizione: vengono tolte da
+    // argv prima di leggere gli argomenti posizionali
+    BenchConfig bench;
+    bench_default_config(&bench);
+    bench.target_time = 0.0;   // di default nessuna calibrazione: repeats iterazioni
+    int use_dia = 0;
+    int fused = FUSED_NONE;
+    int eigen = EIGEN_NONE;
+    int ghost_delta = 0, ghost_float = 0, ghost_refresh = GHOST_DELTA_DEFAULT_REFRESH;
+    double ghost_tol = 0.0;
+    int overlap = OVERLAP_NONE;
+    int exchange = EXCHANGE_DIRECT, exchange_set = 0;
+    const char *trace_file = NULL;
+    int trace_per_rank = 0;
+    const char *report_file = NULL;
+    int adaptive = 0;
+    int dist_2d = 0;
+    int replicate = REPLICATE_AUTO;
+    int ensemble = 0;
+    const char *ensemble_list = NULL;
+    const char *snapshot_file = NULL;
+    int n_pos = 1;
+    for (int a = 1; a < argc; a++) {
+        if (strncmp(argv[a], "--", 2) != 0) {
+            argv[n_pos++] = argv[a];
+            continue;
+        }
+        if (strcmp(argv[a], "--dia") == 0) {
+            use_dia = 1;
+        } else if (strcmp(argv[a], "--fused=axpby") == 0) {
+            fused = FUSED_AXPBY;
+        } else if (strcmp(argv[a], "--fused=xdot") == 0) {
+            fused = FUSED_XDOT;
+        } else if (strcmp(argv[a], "--fused=norm2") == 0) {
+            fused = FUSED_NORM2;
+        } else if (strcmp(argv[a], "--eigen=power") == 0) {
+            eigen = EIGEN_POWER;
+        } else if (strcmp(argv[a], "--eigen=lanczos") == 0) {
+            eigen = EIGEN_LANCZOS;
+        } else if (strcmp(argv[a], "--ghost-delta") == 0) {
+            ghost_delta = 1;
+        } else if (strncmp(argv[a], "--ghost-delta=", 14) == 0 && atof(argv[a] + 14) >= 0.0) {
+            ghost_delta = 1;
+            ghost_tol = atof(argv[a] + 14);
+        } else if (strcmp(argv[a], "--ghost-float") == 0) {
+            ghost_delta = 1;
+            ghost_float = 1;
+        } else if (strncmp(argv[a], "--ghost-refresh=", 16) == 0 && atoi(argv[a] + 16) > 0) {
+            ghost_refresh = atoi(argv[a] + 16);
+        } else if (strcmp(argv[a], "--overlap") == 0 || strcmp(argv[a], "--overlap=task") == 0) {
+            overlap = OVERLAP_TASK;
+        } else if (strcmp(argv[a], "--overlap=p2p") == 0) {
+            overlap = OVERLAP_P2P;
+        } else if (strncmp(argv[a], "--exchange=", 11) == 0) {
+            const char *v = argv[a] + 11;
+            exchange_set = 1;
+            if (strcmp(v, "pack") == 0) exchange = EXCHANGE_PACK;
+            else if (strcmp(v, "direct") == 0) exchange = EXCHANGE_DIRECT;
+            else if (strcmp(v, "datatype") == 0) exchange = EXCHANGE_DATATYPE;
+            else if (strcmp(v, "compare") == 0) exchange = EXCHANGE_COMPARE;
+            else {
+                if (rank == 0) printf("Error: invalid option '%s'\n", argv[a]);
+                MPI_Finalize();
+                return 1;
+            }
+        } else if (strncmp(argv[a], "--trace=", 8) == 0 && argv[a][8] != '\0') {
+            trace_file = argv[a] + 8;
+        } else if (strcmp(argv[a], "--trace-per-rank") == 0) {
+            trace_per_rank = 1;
+        } else if (strncmp(argv[a], "--report-file=", 14) == 0 && argv[a][14] != '\0') {
+            report_file = argv[a] + 14;
+        } else if (strncmp(argv[a], "--adaptive=", 11) == 0 && atoi(argv[a] + 11) > 0) {
+            adaptive = atoi(argv[a] + 11);
+        } else if (strcmp(argv[a], "--dist=1d") == 0) {
+            dist_2d = 0;
+        } else if (strcmp(argv[a], "--dist=2d") == 0) {
+            dist_2d = 1;
+        } else if (strcmp(argv[a], "--replicate-x") == 0 || strcmp(argv[a], "--replicate-x=on") == 0) {
+            replicate = REPLICATE_ON;
+        } else if (strcmp(argv[a], "--replicate-x=off") == 0) {
+            replicate = REPLICATE_OFF;
+        } else if (strcmp(argv[a], "--replicate-x=auto") == 0) {
+            replicate = REPLICATE_AUTO;
+        } else if (strncmp(argv[a], "--ensemble=", 11) == 0 && atoi(argv[a] + 11) > 0) {
+            ensemble = atoi(argv[a] + 11);
+        } else if (strncmp(argv[a], "--ensemble-list=", 16) == 0 && argv[a][16] != '\0') {
+            ensemble_list = argv[a] + 16;
+        } else if (strncmp(argv[a], "--snapshot=", 11) == 0 && argv[a][11] != '\0') {
+            snapshot_file = argv[a] + 11;
+        } else if (alloc_parse_option(argv[a]) != 1 && bench_parse_option(&bench, argv[a]) != 1) {
+            if (rank == 0) printf("Error: invalid option '%s'\n", argv[a]);
+            MPI_Finalize();
+            return 1;
+        }
+    }
+    argc = n_pos;
+
     if (argc < 2) {
         if (rank == 0) {
-            printf("Usage Strong: %s <matrix.mtx> [repeats]\n", argv[0]);
-            printf("Usage Weak:   %s synthetic <repeats> <rows_per_proc> <nnz_per_row>\n", argv[0]);
+            printf("Usage Strong: %s <matrix.mtx> [repeats] [options]\n", argv[0]);
+            printf("Usage Weak:   %s synthetic <repeats> <rows_per_proc> <nnz_per_row> [options]\n", argv[0]);
+            printf("Options:\n           --dia  (DIA storage where the local block is banded)\n");
+            printf("           --fused=axpby|xdot|norm2  (y = aAx + by / x^T A x / ||Ax||^2 in the same sweep)\n");
+            printf("           --eigen=power|lanczos  (chained SpMV: x <- Ax/||Ax||, report extreme eigenvalues)\n");
+            printf("           --ghost-delta[=tol] --ghost-float --ghost-refresh=<n>  (send only changed ghost values)\n");
+            printf("           --overlap[=task|p2p]  (compute interior rows while a task runs the ghost exchange)\n");
+            printf("           --exchange=pack|direct|datatype|compare  (ghost pack/unpack path; compare times all three)\n");
+            printf("           --trace=<file> [--trace-per-rank]  (Chrome/Perfetto JSON timeline of all phases)\n");
+            printf("           --report-file=<file>  (per-run CSV records written with MPI-IO instead of stdout)\n");
+            printf("           --adaptive=<n>  (measure n SpMVs then move rows to balance the observed compute time)\n");
+            printf("           --dist=1d|2d  (cyclic rows with ghost exchange / checkerboard blocks on a process grid)\n");
+            printf("           --replicate-x[=auto|on|off]  (allgather all of x instead of ghosts; auto: N <= %d)\n",
+                   REPLICATE_AUTO_MAX_N);
+            printf("           --ensemble=<G> [--ensemble-list=<file>]  (independent groups of G ranks run concurrently;\n"
+                   "             group g takes line g of the list or a replica of the matrix; reports SpMVs per second)\n");
+            printf("           --snapshot=<file>  (restore local CSR and ghost pattern from file if it matches; else build and write it)\n%s",
+                   bench_options_help());
+            printf("%s", alloc_options_help());
         }
         MPI_Finalize();
         return 1;
     }
 
+    if (exchange_set && ghost_delta) {
+        if (rank == 0) printf("Error: --exchange cannot be combined with --ghost-delta\n");
+        MPI_Finalize();
+        return 1;
+    }
+
+    if (overlap && (fused || eigen || use_dia || (overlap == OVERLAP_P2P && ghost_delta))) {
+        if (rank == 0) printf("Error: --overlap requires the plain CSR kernel (no --fused/--eigen/--dia; p2p without --ghost-delta)\n");
+        MPI_Finalize();
+        return 1;
+    }
+
+    // La distribuzione 2D ha il suo schema di comunicazione: niente ghost,
+    // quindi nessuna delle varianti costruite sopra lo scambio
+    if (dist_2d && (fused || eigen || overlap || ghost_delta || exchange_set || adaptive)) {
+        if (rank == 0) printf("Error: --dist=2d cannot be combined with --fused/--eigen/--overlap/--ghost-delta/--exchange/--adaptive\n");
+        MPI_Finalize();
+        return 1;
+    }
+
+    // x replicato sostituisce lo schema dei ghost: in auto si ripiega in
+    // silenzio sui ghost se serve una variante costruita sopra di esso
+    int ghost_only = overlap || ghost_delta || exchange_set || adaptive || dist_2d;
+    if (replicate == REPLICATE_ON && ghost_only) {
+        if (rank == 0) printf("Error: --replicate-x cannot be combined with --overlap/--ghost-delta/--exchange/--adaptive/--dist=2d\n");
+        MPI_Finalize();
+        return 1;
+    }
+    if (ghost_only) replicate = REPLICATE_OFF;
+
+    // Livello di thread insufficiente: p2p ripiega su un solo task di
+    // comunicazione, sotto SERIALIZED niente sovrapposizione
+    if (overlap == OVERLAP_P2P && provided < MPI_THREAD_MULTIPLE) {
+        overlap = provided >= MPI_THREAD_SERIALIZED ? OVERLAP_TASK : OVERLAP_NONE;
+        if (rank == 0) fprintf(stderr, "Overlap: MPI_THREAD_MULTIPLE not provided, using %s\n", overlap_mode_name(overlap));
+    } else if (overlap == OVERLAP_TASK && provided < MPI_THREAD_SERIALIZED) {
+        overlap = OVERLAP_NONE;
+        if (rank == 0) fprintf(stderr, "Overlap: MPI_THREAD_SERIALIZED not provided, overlap disabled\n");
+    }
+
+    // Prima del caricamento, per tracciare anche lettura e distribuzione;
+    // la traccia resta unica per tutto il job anche con --ensemble
+    if (trace_file) trace_init(trace_file, trace_per_rank);
+
     char *arg1 = argv[1];
     int is_synthetic = (strcmp(arg1, "synthetic") == 0);
+
+    // --ensemble: gruppi indipendenti di G rank consecutivi, ognuno con la sua
+    // matrice e il suo comunicatore. Da qui rank e size sono quelli del gruppo
+    MPI_Comm group_comm = MPI_COMM_WORLD;
+    int group_id = 0;
+    char group_matrix[1024];
+    if (ensemble > 0) {
+        group_id = rank / ensemble;
+        MPI_Comm_split(MPI_COMM_WORLD, group_id, rank, &group_comm);
+        MPI_Comm_rank(group_comm, &rank);
+        MPI_Comm_size(group_comm, &size);
+    }
+    if (ensemble_list) {
+        int bad = ensemble <= 0 || is_synthetic || !ensemble_matrix(ensemble_list, group_id, group_matrix, sizeof(group_matrix));
+        if (job_error(bad)) {
+            if (rank == 0 && bad) printf("Error: --ensemble-list needs --ensemble=<G> a matrix file and a readable non-empty list\n");
+            MPI_Finalize();
+            return 1;
+        }
+        arg1 = group_matrix;
+    }
+    // Diagnostica e tabelle di dettaglio: solo il primo gruppo
+    int leader = (rank == 0 && group_id == 0);
     int repeats = 10; 
 
     LocalCSR local_mat = {0};
-    int M_glob, N_glob, nz_glob;
+    int M_glob, N_glob;
+    long long nz_glob;
+    Grid2D *grid = NULL;
+    CommInfo comm = {0};
+    comm.mpi_comm = group_comm;
+    Partition *part = NULL;
 
+    int rows_pp = 0, nnz_pp = 0;
     if (is_synthetic) {
+        if (dist_2d) {
+            if (rank == 0) printf("Error: --dist=2d requires a matrix file\n");
+            MPI_Finalize();
+            return 1;
+        }
 
         if (argc < 5) {
             if (rank == 0) printf("Error: Synthetic mode requires: synthetic <repeats> <rows_per_proc> <nnz_per_row>\n");
@@ -57,108 +366,356 @@ int main(int argc, char *argv[]) {
             return 1;
         }
         repeats = atoi(argv[2]);
-        int rows_pp = atoi(argv[3]);
-        int nnz_pp = atoi(argv[4]);
-        
-        generate_synthetic_matrix(rows_pp, nnz_pp, rank, size, &local_mat, &M_glob, &N_glob, &nz_glob);
-        
+        rows_pp = atoi(argv[3]);
+        nnz_pp = atoi(argv[4]);
+    } else if (argc > 2) {
+        repeats = atoi(argv[2]);
+    }
+
+    // --snapshot: se il file corrisponde a questa configurazione (rank,
+    // distribuzione, matrice) si salta tutto fino al ciclo misurato
+    SnapshotHeader snap = {{0}};
+    char snap_path[1100];
+    int restored = 0;
+    double t_build = MPI_Wtime();
+    if (snapshot_file) {
+        memcpy(snap.magic, SNAPSHOT_MAGIC, 8);
+        snap.size = size;
+        snap.index_bytes = sizeof(spmv_nnz_t);
+        if (is_synthetic) snprintf(snap.name, SNAPSHOT_NAME_MAX, "synthetic %d %d", rows_pp, nnz_pp);
+        else {
+            // Copia troncata esplicita: snprintf/strncpy da arg1 (1024 byte)
+            // danno -Wformat-truncation / -Wstringop-truncation con -Wall
+            size_t len = strlen(arg1) < SNAPSHOT_NAME_MAX - 1 ? strlen(arg1) : SNAPSHOT_NAME_MAX - 1;
+            memcpy(snap.name, arg1, len);
+            snapshot_stamp_source(arg1, group_comm, &snap);
+        }
+        // Un file per gruppo: con --ensemble le matrici possono essere diverse
+        if (ensemble > 0) snprintf(snap_path, sizeof(snap_path), "%s.g%d", snapshot_file, group_id);
+        else snprintf(snap_path, sizeof(snap_path), "%s", snapshot_file);
+
+        SnapshotHeader found;
+        if (snapshot_probe(snap_path, group_comm, &found)) {
+            int kind = dist_2d ? SNAPSHOT_GRID2D : adaptive ? SNAPSHOT_BLOCKS :
+                       use_replicated_x(replicate, size, found.N) ? SNAPSHOT_REPLICATED : SNAPSHOT_CYCLIC;
+            int same_config = found.size == size && found.kind == kind &&
+                              found.index_bytes == snap.index_bytes && strcmp(found.name, snap.name) == 0;
+            int same_source = found.source_bytes == snap.source_bytes &&
+                              found.source_mtime == snap.source_mtime;
+            if (same_config && same_source) {
+                snapshot_read(snap_path, group_comm, &found, &local_mat, &comm, &part);
+                M_glob = found.M;
+                N_glob = found.N;
+                nz_glob = found.nz;
+                restored = 1;
+                if (leader) fprintf(stderr, "Snapshot: restored %s in %.3f s\n", snap_path, MPI_Wtime() - t_build);
+            } else if (leader && same_config) {
+                fprintf(stderr, "Snapshot: %s is out of date (matrix file changed) and will be replaced\n", snap_path);
+            } else if (leader) {
+                fprintf(stderr, "Snapshot: %s was written for another configuration and will be replaced\n", snap_path);
+            }
+        }
+    }
+
+    if (restored) {
+        if (dist_2d) {
+            grid = grid2d_create(group_comm);
+            grid2d_set_size(grid, M_glob, N_glob);
+        }
+    } else if (is_synthetic) {
+        TRACE_BEGIN(t_gen);
+        generate_synthetic_matrix(rows_pp, nnz_pp, group_comm, &local_mat, &M_glob, &N_glob, &nz_glob);
+        TRACE_END("generate", t_gen);
     } else {
-        if (argc > 2) repeats = atoi(argv[2]);
-        load_and_scatter_matrix(arg1, rank, size, &local_mat, &M_glob, &N_glob, &nz_glob);
+        if (dist_2d) grid = grid2d_create(group_comm);
+        load_and_scatter_matrix(arg1, group_comm, grid, &local_mat, &M_glob, &N_glob, &nz_glob);
     }
     
-    CommInfo comm = {0};
-    setup_communication_pattern(&local_mat, &comm, rank, size, N_glob);
+    if (grid) {
+        // Nessuno schema di ghost: ai fini del report i "ghost" sono gli
+        // elementi di x_j ricevuti dagli altri rank della colonna di processi
+        comm.num_ghosts = (grid->col_end - grid->col_begin) - grid->x_piece;
+        comm.total_to_send = grid->x_piece * (grid->pr - 1);
+        if (leader) {
+            fprintf(stderr, "2D grid: %d x %d processes (blocks of about %d x %d)\n", grid->pr, grid->pc,
+                    M_glob / grid->pr, N_glob / grid->pc);
+        }
+    } else if (use_replicated_x(replicate, size, N_glob)) {
+        if (!restored) {
+            TRACE_BEGIN(t_setup);
+            setup_replicated_x(&local_mat, &comm, group_comm, N_glob);
+            TRACE_END("comm_setup", t_setup);
+        }
+        if (leader) {
+            fprintf(stderr, "Replicated x: %d entries allgathered per iteration (%s)\n", N_glob,
+                    replicate == REPLICATE_ON ? "forced" : "auto");
+        }
+    } else if (!restored) {
+        TRACE_BEGIN(t_setup);
+        setup_communication_pattern(&local_mat, &comm, group_comm, N_glob);
+        TRACE_END("comm_setup", t_setup);
+    }
+
+    // Ridistribuzione prima di tutto ciò che dipende dalle righe locali
+    // (DIA, overlap, vettori, tipi MPI); uno snapshot contiene già il risultato
+    // --adaptive (una partizione per righe e x), --eigen (y diventa x) e
+    // --fused=xdot (x[i] letto per ogni riga locale, già nel pilota) vogliono
+    // M = N; con --ensemble-list la condizione può valere in un solo gruppo
+    const char *square_opt = adaptive > 0 ? "--adaptive" : eigen ? "--eigen" :
+                             fused == FUSED_XDOT ? "--fused=xdot" : NULL;
+    int not_square = square_opt && M_glob != N_glob;
+    if (job_error(not_square)) {
+        if (rank == 0 && not_square) {
+            if (ensemble > 0) printf("Error: %s requires a square matrix (group %d has %d x %d)\n", square_opt, group_id, M_glob, N_glob);
+            else printf("Error: %s requires a square matrix (got %d x %d)\n", square_opt, M_glob, N_glob);
+        }
+        MPI_Finalize();
+        return 1;
+    }
+    if (adaptive > 0 && !restored) {
+        TRACE_BEGIN(t_repart);
+        int x_dim = partition_count(NULL, N_glob, rank, size);
+        double t_before = repartition_measure(&local_mat, &comm, x_dim, adaptive);
+        double nz_before = local_mat.n_local_nz;
+        long long rows_moved = 0;
+        part = repartition_by_cost(&local_mat, &comm, t_before, M_glob, N_glob, &rows_moved);
+        x_dim = partition_count(part, N_glob, rank, size);
+        double t_after = repartition_measure(&local_mat, &comm, x_dim, adaptive);
+        double nz_after = local_mat.n_local_nz;
+
+        // Squilibrio = max / media, sul tempo misurato e sui nonzeri
+        double loc[4] = {t_before, t_after, nz_before, nz_after}, mx[4], sum[4];
+        MPI_Reduce(loc, mx, 4, MPI_DOUBLE, MPI_MAX, 0, group_comm);
+        MPI_Reduce(loc, sum, 4, MPI_DOUBLE, MPI_SUM, 0, group_comm);
+        if (leader) {
+            double imb[4];
+            for (int k = 0; k < 4; k++) imb[k] = sum[k] > 0.0 ? mx[k] * size / sum[k] : 0.0;
+            fprintf(stderr, "Repartition: compute imbalance %.3f -> %.3f (max/avg over %d SpMVs) nnz imbalance %.3f -> %.3f rows moved %lld\n",
+                    imb[0], imb[1], adaptive, imb[2], imb[3], rows_moved);
+        }
+        TRACE_END("repartition", t_repart);
+    }
+
+    // Righe locali e schema dei ghost definitivi: tipi MPI, delta, DIA e
+    // overlap si ricostruiscono a ogni avvio perché costano poco
+    if (snapshot_file && !restored) {
+        double t_setup_done = MPI_Wtime();
+        snap.kind = grid ? SNAPSHOT_GRID2D : part ? SNAPSHOT_BLOCKS :
+                    comm.exchange_mode == EXCHANGE_REPLICATED ? SNAPSHOT_REPLICATED : SNAPSHOT_CYCLIC;
+        snap.M = M_glob;
+        snap.N = N_glob;
+        snap.nz = nz_glob;
+        long long bytes = snapshot_write(snap_path, group_comm, &snap, &local_mat, &comm, part);
+        if (leader && bytes > 0) {
+            fprintf(stderr, "Snapshot: wrote %s (%lld bytes) in %.3f s after %.3f s of load and setup\n",
+                    snap_path, bytes, MPI_Wtime() - t_setup_done, t_setup_done - t_build);
+        }
+    }
+
+    if (!grid && comm.exchange_mode != EXCHANGE_REPLICATED) {
+        TRACE_BEGIN(t_exch_setup);
+        setup_exchange(&comm, exchange == EXCHANGE_COMPARE ? EXCHANGE_DATATYPE : exchange);
+        if (ghost_delta) setup_ghost_delta(&comm, ghost_tol, ghost_float, ghost_refresh);
+        TRACE_END("exchange_setup", t_exch_setup);
+    }
 
     
-    int my_x_dim = 0;
-   
-    int chunk = (N_glob + size - 1) / size; 
-    int start_col = rank * chunk;
-    int end_col = (rank + 1) * chunk;
-    if (end_col > N_glob) end_col = N_glob;
-    my_x_dim = end_col - start_col;
+    // x è distribuito come le righe: ciclico (GET_OWNER) o a blocchi dopo --adaptive;
+    // in 2D ogni rank possiede un pezzo di x_j e uno di y_i
+    int my_x_dim = grid ? grid->x_piece : partition_count(local_mat.part, N_glob, rank, size);
     if (my_x_dim < 0) my_x_dim = 0;
     
-    double *full_x = malloc((my_x_dim + comm.num_ghosts) * sizeof(double));
-    double *local_y = malloc(local_mat.n_local_rows * sizeof(double));
+    // DIA sulle colonne locali già rimappate: ogni rank decide da solo, i
+    // rank senza diagonali dominanti restano in CSR
+    if (use_dia) {
+        int n_cols = grid ? grid->col_end - grid->col_begin : my_x_dim + comm.num_ghosts;
+        local_mat.dia = build_dia(&local_mat, n_cols);
+        if (local_mat.dia) {
+            int n = local_mat.n_local_rows > 0 ? local_mat.n_local_rows : 1;
+            local_mat.dia_tmp = alloc_array(n * sizeof(double));
+        }
+        int my_dia = local_mat.dia ? 1 : 0, n_dia = 0;
+        double my_cov = local_mat.dia ? local_mat.dia->coverage : 0.0, min_cov = 0.0;
+        MPI_Reduce(&my_dia, &n_dia, 1, MPI_INT, MPI_SUM, 0, group_comm);
+        MPI_Reduce(&my_cov, &min_cov, 1, MPI_DOUBLE, MPI_MIN, 0, group_comm);
+        if (leader) {
+            fprintf(stderr, "DIA: %d of %d ranks use diagonal storage (min coverage %.3f)\n",
+                    n_dia, size, min_cov);
+        }
+    }
+
+    OverlapPlan *op = NULL;
+    if (overlap) {
+        op = overlap_create(&local_mat, &comm, my_x_dim, overlap);
+        long long my_rows[2] = {op->n_interior, local_mat.n_local_rows}, tot_rows[2] = {0, 0};
+        MPI_Reduce(my_rows, tot_rows, 2, MPI_LONG_LONG, MPI_SUM, 0, group_comm);
+        if (leader) {
+            fprintf(stderr, "Overlap: %s mode with %d threads per rank (interior rows %.1f%%)\n",
+                    overlap_mode_name(overlap), omp_get_max_threads(),
+                    tot_rows[1] > 0 ? 100.0 * tot_rows[0] / tot_rows[1] : 0.0);
+        }
+    }
+
+    double *full_x = alloc_zeroed(my_x_dim + comm.num_ghosts, sizeof(double));
+    double *local_y = alloc_zeroed(grid ? grid->y_piece : local_mat.n_local_rows, sizeof(double));
+    if (leader) fprintf(stderr, "Alloc policy: %s\n", alloc_policy_string());
     
     srand(rank * 1234); 
     for(int i=0; i<my_x_dim; i++) full_x[i] = ((double)rand() / RAND_MAX) * 2.0 - 1.0; 
 
+    // Stesso scambio con le tre varianti, prima del benchmark; poi si
+    // prosegue con la ricezione diretta
+    if (exchange == EXCHANGE_COMPARE) {
+        double t_mode[3], t_max[3];
+        for (int mode = EXCHANGE_PACK; mode <= EXCHANGE_DATATYPE; mode++) {
+            comm.exchange_mode = mode;
+            perform_ghost_exchange(&comm, full_x, my_x_dim);
+            MPI_Barrier(group_comm);
+            double t0 = MPI_Wtime();
+            for (int k = 0; k < EXCHANGE_COMPARE_REPS; k++) perform_ghost_exchange(&comm, full_x, my_x_dim);
+            t_mode[mode] = (MPI_Wtime() - t0) / EXCHANGE_COMPARE_REPS;
+        }
+        MPI_Reduce(t_mode, t_max, 3, MPI_DOUBLE, MPI_MAX, 0, group_comm);
+        if (leader) {
+            fprintf(stderr, "Exchange (slowest rank mean of %d): pack %.3f us direct %.3f us datatype %.3f us\n",
+                    EXCHANGE_COMPARE_REPS, t_max[0] * 1e6, t_max[1] * 1e6, t_max[2] * 1e6);
+        }
+        comm.exchange_mode = EXCHANGE_DIRECT;
+    }
+
+    // Riscaldamento non misurato; l'ultima iterazione fa da pilota e il
+    // massimo tra i rank fissa lo stesso numero di iterazioni per tutti
+    bench.min_iters = repeats;
+    double pilot = 0.0;
+    int n_warmup = bench.warmup > 0 ? bench.warmup : 1;
+    for (int w = 0; w < n_warmup; w++) {
+        MPI_Barrier(group_comm);
+        double t_w = MPI_Wtime();
+        if (grid) {
+            double t_c;
+            grid2d_spmv(grid, &local_mat, full_x, local_y, &t_c);
+        } else if (op) {
+            overlap_spmv(op, &local_mat, &comm, full_x, local_y, my_x_dim);
+        } else {
+            perform_ghost_exchange(&comm, full_x, my_x_dim);
+            local_step(fused, group_comm, &local_mat, full_x, local_y);
+        }
+        pilot = MPI_Wtime() - t_w;
+    }
+    double pilot_max = 0.0;
+    MPI_Allreduce(&pilot, &pilot_max, 1, MPI_DOUBLE, MPI_MAX, group_comm);
+    repeats = bench_iterations_for(&bench, pilot_max);
+
+    // Catena di SpMV: y di un passo è la x del successivo, ghost compresi
+    EigenState *es = NULL;
+    if (eigen) {
+        es = eigen_create(&local_mat, group_comm, my_x_dim + comm.num_ghosts, eigen, repeats);
+    }
+
     double *run_total_times = (double*)malloc(repeats * sizeof(double));
     double *run_comm_times  = (double*)malloc(repeats * sizeof(double));
-
-    perform_ghost_exchange(&comm, full_x, my_x_dim);
-    compute_spmv(&local_mat, full_x, local_y);
     
-    MPI_Barrier(MPI_COMM_WORLD);
+    double fused_value = 0.0;
+    if (comm.delta) comm.delta->bytes_sent = comm.delta->bytes_plain = 0.0;
+    MPI_Barrier(group_comm);
+    double t_loop = MPI_Wtime();
 
     for(int r=0; r<repeats; r++) {
-        MPI_Barrier(MPI_COMM_WORLD);
+        if (bench.flush_cache) bench_flush_cache();
+        TRACE_BEGIN(t_barrier);
+        MPI_Barrier(group_comm);
+        TRACE_END("barrier", t_barrier);
         
         double t_start = MPI_Wtime();
+        double t_comm;
         
-        perform_ghost_exchange(&comm, full_x, my_x_dim);
-        double t_after_comm = MPI_Wtime();
-        
-        compute_spmv(&local_mat, full_x, local_y);
+        if (grid) {
+            grid2d_spmv(grid, &local_mat, full_x, local_y, &t_comm);
+        } else if (op) {
+            // comm_time = durata del task di comunicazione, in parte nascosta
+            t_comm = overlap_spmv(op, &local_mat, &comm, full_x, local_y, my_x_dim);
+        } else {
+            perform_ghost_exchange(&comm, es ? es->v : full_x, my_x_dim);
+            t_comm = MPI_Wtime() - t_start;
+
+            TRACE_BEGIN(t_compute);
+            if (es) eigen_step(es, &local_mat);
+            else fused_value = local_step(fused, group_comm, &local_mat, full_x, local_y);
+            TRACE_END("compute", t_compute);
+        }
         double t_end = MPI_Wtime();
+        if (trace_enabled) trace_event("iteration", t_start, t_end);
         
-        run_comm_times[r] = t_after_comm - t_after_comm; 
-        run_comm_times[r] = t_after_comm - t_start;
+        run_comm_times[r] = t_comm;
         run_total_times[r] = t_end - t_start;
+
+        // Sottospazio invariante: beta è globale, tutti i rank si fermano insieme
+        if (es && es->breakdown) {
+            repeats = r + 1;
+            break;
+        }
     }
+    // Durata del ciclo misurato: con --ensemble dà le SpMV al secondo del gruppo
+    t_loop = MPI_Wtime() - t_loop;
     
     
     char display_name[64];
     if (is_synthetic) snprintf(display_name, 64, "synthetic_np%d", size);
     else strncpy(display_name, arg1, 64);
 
-    for (int p=0; p<size; p++) {
-        MPI_Barrier(MPI_COMM_WORLD);
-        if (rank == p) {
-            if (p==0 && rank==0) {
-                // Header CSV
-                printf("matrix_name,rank,num_procs,run,elapsed_time,comm_time,local_nz,ghost_entries,local_flops\n");
-            }
-            long long my_flops = 2LL * local_mat.n_local_nz;
-            for(int r=0; r<repeats; r++) {
-                printf("%s,%d,%d,%d,%.9f,%.9f,%d,%d,%lld\n", 
-                       display_name, rank, size, r, run_total_times[r], run_comm_times[r], 
-                       local_mat.n_local_nz, comm.num_ghosts, my_flops);
-            }
-        }
+    TRACE_BEGIN(t_csv);
+    ReportInfo info = {group_comm, display_name, rank, size, local_mat.n_local_nz, comm.num_ghosts,
+                       2LL * local_mat.n_local_nz};
+    if (group_id == 0) {
+        report_runs(&info, run_total_times, run_comm_times, repeats, report_file);
+        report_phase_stats(&info, run_total_times, run_comm_times, repeats);
     }
+    TRACE_END("csv_output", t_csv);
 
    
-    double *sorted_times = malloc(repeats * sizeof(double));
-    for(int i=0; i<repeats; i++) sorted_times[i] = run_total_times[i];
-    qsort(sorted_times, repeats, sizeof(double), compare_doubles);
-    
-    int p90_idx = (int)(repeats * 0.90);
-    if(p90_idx >= repeats) p90_idx = repeats - 1;
-    double my_p90 = sorted_times[p90_idx];
+    BenchStats my_stats;
+    bench_compute_stats(run_total_times, repeats, &my_stats);
+    double my_p90 = my_stats.p90;
+
+    // Tempo di sistema di ogni iterazione = rank più lento
+    double *system_times = (rank == 0) ? malloc(repeats * sizeof(double)) : NULL;
+    MPI_Reduce(run_total_times, system_times, repeats, MPI_DOUBLE, MPI_MAX, 0, group_comm);
+
+    // Byte minimi per iterazione: CSR locale, x locale + ghost, y, buffer di scambio
+    double my_bytes = (double)local_mat.n_local_nz * (sizeof(double) + sizeof(int))
+                    + (double)(local_mat.n_local_rows + 1) * sizeof(spmv_nnz_t)
+                    + (double)(my_x_dim + comm.num_ghosts) * sizeof(double)
+                    + (double)local_mat.n_local_rows * sizeof(double)
+                    + 2.0 * (comm.total_to_send + comm.num_ghosts) * sizeof(double);
+    double total_bytes = 0.0;
+    MPI_Reduce(&my_bytes, &total_bytes, 1, MPI_DOUBLE, MPI_SUM, 0, group_comm);
     
-    free(sorted_times); free(run_total_times); free(run_comm_times);
+    free(run_total_times); free(run_comm_times);
+
+    double ghost_bytes[2] = {0.0, 0.0}, ghost_bytes_tot[2] = {0.0, 0.0};
+    if (comm.delta) {
+        ghost_bytes[0] = comm.delta->bytes_sent;
+        ghost_bytes[1] = comm.delta->bytes_plain;
+        MPI_Reduce(ghost_bytes, ghost_bytes_tot, 2, MPI_DOUBLE, MPI_SUM, 0, group_comm);
+    }
 
     double global_max_p90 = 0.0;
-    MPI_Reduce(&my_p90, &global_max_p90, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&my_p90, &global_max_p90, 1, MPI_DOUBLE, MPI_MAX, 0, group_comm);
     
     long long my_nz = local_mat.n_local_nz;
     long long total_flops_sym = 0;
     long long my_flops_calc = 2LL * my_nz;
-    MPI_Reduce(&my_flops_calc, &total_flops_sym, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&my_flops_calc, &total_flops_sym, 1, MPI_LONG_LONG, MPI_SUM, 0, group_comm);
 
     long long my_ghosts = comm.num_ghosts;
     long long min_g, max_g, sum_g, max_nz, sum_nz;
-    MPI_Reduce(&my_ghosts, &min_g, 1, MPI_LONG_LONG, MPI_MIN, 0, MPI_COMM_WORLD);
-    MPI_Reduce(&my_ghosts, &max_g, 1, MPI_LONG_LONG, MPI_MAX, 0, MPI_COMM_WORLD);
-    MPI_Reduce(&my_ghosts, &sum_g, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
-    MPI_Reduce(&my_nz, &max_nz, 1, MPI_LONG_LONG, MPI_MAX, 0, MPI_COMM_WORLD);
-    MPI_Reduce(&my_nz, &sum_nz, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&my_ghosts, &min_g, 1, MPI_LONG_LONG, MPI_MIN, 0, group_comm);
+    MPI_Reduce(&my_ghosts, &max_g, 1, MPI_LONG_LONG, MPI_MAX, 0, group_comm);
+    MPI_Reduce(&my_ghosts, &sum_g, 1, MPI_LONG_LONG, MPI_SUM, 0, group_comm);
+    MPI_Reduce(&my_nz, &max_nz, 1, MPI_LONG_LONG, MPI_MAX, 0, group_comm);
+    MPI_Reduce(&my_nz, &sum_nz, 1, MPI_LONG_LONG, MPI_SUM, 0, group_comm);
 
-    if (rank == 0) {
+    if (leader) {
         double avg_g = (double)sum_g / size;
         double avg_nz = (double)sum_nz / size;
         double imb_ratio = (avg_nz > 0) ? (double)max_nz / avg_nz : 0.0;
@@ -169,13 +726,53 @@ int main(int argc, char *argv[]) {
         printf("%s,%d,%lld,%.2f,%lld,%.4f,%.9f,%.4f\n", 
                display_name, size, min_g, avg_g, max_g, imb_ratio, global_max_p90, gflops);
         printf("=============================\n");
+
+        BenchStats sys_stats;
+        char config[64];
+        bench_compute_stats(system_times, repeats, &sys_stats);
+        snprintf(config, sizeof(config), "np%d%s%s", size, es ? "/eigen-" : "", es ? eigen_mode_name(eigen) : "");
+        bench_print_stats(display_name, &sys_stats);
+        if (fused == FUSED_XDOT || fused == FUSED_NORM2) {
+            fprintf(stderr, "Fused %s: last value %.9e\n", fused == FUSED_XDOT ? "x^T A x" : "||Ax||^2",
+                    fused_value);
+        }
+        if (comm.delta) {
+            double sent = ghost_bytes_tot[0] / repeats, plain = ghost_bytes_tot[1] / repeats;
+            fprintf(stderr, "Ghost delta: %.0f bytes per iteration instead of %.0f (%.1f%% saved) tol %g %s values full refresh every %d\n",
+                    sent, plain, plain > 0.0 ? 100.0 * (1.0 - sent / plain) : 0.0, ghost_tol,
+                    ghost_float ? "float" : "double", ghost_refresh);
+        }
+        if (es) {
+            double lmin, lmax;
+            eigen_estimate(es, &lmin, &lmax);
+            if (eigen == EIGEN_POWER) {
+                fprintf(stderr, "Eigen power: dominant eigenvalue %.10e after %d iterations (%.6f ms per iteration)\n",
+                        lmax, es->steps, sys_stats.mean * 1000);
+            } else {
+                fprintf(stderr, "Eigen lanczos: lambda_min %.10e lambda_max %.10e after %d iterations%s (%.6f ms per iteration)\n",
+                        lmin, lmax, es->steps, es->breakdown ? " (invariant subspace)" : "", sys_stats.mean * 1000);
+            }
+        }
+        bench_write_results(&bench, display_name, config, &sys_stats, (double)total_flops_sym, total_bytes);
     }
+    free(system_times);
+
+    if (ensemble > 0) report_ensemble(&info, group_id, repeats, t_loop);
 
     free(local_mat.val);
     free(local_mat.col_ind);
     free(local_mat.row_ptr);
+    free_dia(local_mat.dia);
+    free(local_mat.dia_tmp);
     free(full_x);
     free(local_y);
+    free_eigen_state(es);
+    free_overlap_plan(op);
+    free_partition(part);
+    free_grid2d(grid);
+    if (group_comm != MPI_COMM_WORLD) MPI_Comm_free(&group_comm);
+
+    trace_finalize();
     
     MPI_Finalize();
     return 0;
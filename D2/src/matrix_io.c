@@ -1,9 +1,26 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include "matrix_io.h"
 #include "mmio.h"
+#include "alloc.h"
 
+// Come mm_read_mtx_crd_size, ma con nz a 64 bit: le dimensioni restano int,
+// i nonzeri del file possono superare 2^31
+static int read_size_line(FILE *f, int *M, int *N, long long *nz) {
+    char line[MM_MAX_LINE_LENGTH];
+    long long m, n;
+    do {
+        if (fgets(line, MM_MAX_LINE_LENGTH, f) == NULL) return MM_PREMATURE_EOF;
+    } while (line[0] == '%' || line[strspn(line, " \t\r\n")] == '\0');
+
+    if (sscanf(line, "%lld %lld %lld", &m, &n, nz) != 3) return MM_PREMATURE_EOF;
+    if (m <= 0 || n <= 0 || m > INT_MAX || n > INT_MAX || *nz < 0) return MM_COULD_NOT_READ_FILE;
+    *M = (int)m;
+    *N = (int)n;
+    return 0;
+}
 
 Matrix* read_matrix(const char *filename) {
     Matrix *mat = (Matrix*)malloc(sizeof(Matrix));
@@ -31,21 +48,30 @@ Matrix* read_matrix(const char *filename) {
            exit(1);
        }
 
-       if (mm_read_mtx_crd_size(f, &mat->M, &mat->N, &mat->nz) != 0) {
-           fprintf(stderr, "Error reading matrix size.\n");
+       long long file_nz;
+       if (read_size_line(f, &mat->M, &mat->N, &file_nz) != 0) {
+           fprintf(stderr, "Error reading matrix size (dimensions must fit in 32 bits).\n");
+           exit(1);
+       }
+
+       long long max_nz = mm_is_symmetric(matcode) ? (2 * file_nz) : file_nz;
+#ifndef SPMV_INDEX64
+       if (max_nz > INT_MAX) {
+           fprintf(stderr, "Error: %lld nonzeros need 64-bit indices (compile with -DSPMV_INDEX64).\n", max_nz);
            exit(1);
        }
+#endif
+       mat->nz = (spmv_nnz_t)file_nz;
 
-       printf("Matrix size: %d x %d, NNZ (file): %d\n", mat->M, mat->N, mat->nz);
+       printf("Matrix size: %d x %d, NNZ (file): %lld\n", mat->M, mat->N, file_nz);
 
-       int max_nz = mm_is_symmetric(matcode) ? (2 * mat->nz) : mat->nz;
-       mat->I = (int*)malloc(max_nz * sizeof(int));
-       mat->J = (int*)malloc(max_nz * sizeof(int));
-       mat->val = (double*)malloc(max_nz * sizeof(double));
+       mat->I = (int*)alloc_array((size_t)max_nz * sizeof(int));
+       mat->J = (int*)alloc_array((size_t)max_nz * sizeof(int));
+       mat->val = (double*)alloc_array((size_t)max_nz * sizeof(double));
 
-       int nz_actual = 0;
+       spmv_nnz_t nz_actual = 0;
        
-       for (int i = 0; i < mat->nz; i++) {
+       for (spmv_nnz_t i = 0; i < mat->nz; i++) {
            int row, col;
            double value = 1.0;  
            
@@ -77,7 +103,7 @@ Matrix* read_matrix(const char *filename) {
        mat->nz = nz_actual;
        mat->is_symmetric = mm_is_symmetric(matcode);
        
-       printf("Actual NNZ (after symmetry expansion): %d\n\n", mat->nz);
+       printf("Actual NNZ (after symmetry expansion): %lld\n\n", (long long)mat->nz);
        
        return mat;
 }
@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+#ifdef _OPENMP
+    #include <omp.h>
+#else
+    #define omp_get_thread_num() 0
+    #define omp_get_num_threads() 1
+    #define omp_get_max_threads() 1
+#endif
+#include "structures.h"
+#include "trace.h"
+
+void perform_ghost_exchange(CommInfo *c, double *x, int dim);
+
+OverlapPlan* overlap_create(LocalCSR *mat, CommInfo *comm, int x_dim, int mode) {
+    int size;
+    MPI_Comm_size(comm->mpi_comm, &size);
+
+    OverlapPlan *op = calloc(1, sizeof(OverlapPlan));
+    op->mode = mode;
+
+    // Righe interne: solo colonne locali (< x_dim), calcolabili prima che
+    // arrivino i ghost. Le altre aspettano lo scambio
+    op->interior_rows = malloc((mat->n_local_rows > 0 ? mat->n_local_rows : 1) * sizeof(int));
+    op->boundary_rows = malloc((mat->n_local_rows > 0 ? mat->n_local_rows : 1) * sizeof(int));
+    for (int i = 0; i < mat->n_local_rows; i++) {
+        int is_boundary = 0;
+        for (spmv_nnz_t j = mat->row_ptr[i]; j < mat->row_ptr[i+1]; j++) {
+            if (mat->col_ind[j] >= x_dim) {
+                is_boundary = 1;
+                break;
+            }
+        }
+        if (is_boundary) op->boundary_rows[op->n_boundary++] = i;
+        else op->interior_rows[op->n_interior++] = i;
+    }
+
+    // Qualche task per thread: abbastanza per bilanciare, non troppi da gestire
+    int nt = omp_get_max_threads();
+    op->task_rows = mat->n_local_rows / (OVERLAP_TASKS_PER_THREAD * nt);
+    if (op->task_rows < OVERLAP_MIN_TASK_ROWS) op->task_rows = OVERLAP_MIN_TASK_ROWS;
+
+    // p2p: vicini divisi in gruppi contigui, un task di comunicazione per gruppo
+    op->neighbors = malloc(size * sizeof(int));
+    for (int p = 0; p < size; p++) {
+        if (comm->send_counts[p] > 0 || comm->recv_counts[p] > 0) op->neighbors[op->n_neighbors++] = p;
+    }
+    op->n_groups = nt > 1 ? nt - 1 : 1;
+    if (op->n_groups > op->n_neighbors) op->n_groups = op->n_neighbors;
+    op->reqs = malloc((2 * op->n_neighbors + 1) * sizeof(MPI_Request));
+    return op;
+}
+
+static void spmv_rows(const char *phase, LocalCSR *mat, const int *rows, int begin, int end, double *x, double *y) {
+    TRACE_BEGIN(t);
+    for (int k = begin; k < end; k++) {
+        int i = rows[k];
+        double sum = 0.0;
+        for (spmv_nnz_t j = mat->row_ptr[i]; j < mat->row_ptr[i+1]; j++) {
+            sum += mat->val[j] * x[mat->col_ind[j]];
+        }
+        y[i] = sum;
+    }
+    TRACE_END(phase, t);
+}
+
+// Scambio dei vicini [first, last) di op->neighbors: ogni gruppo usa le sue
+// richieste, quindi più thread chiamano MPI insieme (MPI_THREAD_MULTIPLE).
+// I ghost arrivano direttamente nella loro posizione in x
+static void exchange_group(OverlapPlan *op, CommInfo *comm, double *x, int x_dim, int first, int last) {
+    TRACE_BEGIN(t);
+    MPI_Request *reqs = op->reqs + 2 * first;
+    int n_req = 0;
+    for (int k = first; k < last; k++) {
+        int p = op->neighbors[k];
+        if (comm->recv_counts[p] > 0) {
+            MPI_Irecv(x + x_dim + comm->rdispls[p], comm->recv_counts[p], MPI_DOUBLE, p,
+                      OVERLAP_TAG, comm->mpi_comm, &reqs[n_req++]);
+        }
+    }
+    for (int k = first; k < last; k++) {
+        int p = op->neighbors[k];
+        if (comm->send_counts[p] == 0) continue;
+        double *buf = comm->send_buffer + comm->sdispls[p];
+        const int *idx = comm->export_indices + comm->sdispls[p];
+        for (int i = 0; i < comm->send_counts[p]; i++) buf[i] = x[idx[i]];
+        MPI_Isend(buf, comm->send_counts[p], MPI_DOUBLE, p, OVERLAP_TAG, comm->mpi_comm, &reqs[n_req++]);
+    }
+    MPI_Waitall(n_req, reqs, MPI_STATUSES_IGNORE);
+    TRACE_END("p2p_group", t);
+}
+
+double overlap_spmv(OverlapPlan *op, LocalCSR *mat, CommInfo *comm, double *x, double *y, int x_dim) {
+    double comm_time = 0.0;
+    char ghosts_ready = 0;    // solo come oggetto delle dipendenze tra task
+
+    #pragma omp parallel
+    #pragma omp single
+    {
+        // Il task di comunicazione è creato per primo: lo prende il primo
+        // thread libero, gli altri calcolano le righe interne
+        #pragma omp task depend(out: ghosts_ready) shared(comm_time)
+        {
+            double t = MPI_Wtime();
+            if (op->mode == OVERLAP_P2P) {
+                for (int g = 0; g < op->n_groups; g++) {
+                    int first = (int)((long)op->n_neighbors * g / op->n_groups);
+                    int last = (int)((long)op->n_neighbors * (g + 1) / op->n_groups);
+                    #pragma omp task firstprivate(first, last)
+                    exchange_group(op, comm, x, x_dim, first, last);
+                }
+                #pragma omp taskwait
+            } else {
+                perform_ghost_exchange(comm, x, x_dim);
+            }
+            comm_time = MPI_Wtime() - t;
+            if (trace_enabled) trace_event("comm_task", t, t + comm_time);
+        }
+
+        for (int b = 0; b < op->n_interior; b += op->task_rows) {
+            int e = b + op->task_rows < op->n_interior ? b + op->task_rows : op->n_interior;
+            #pragma omp task firstprivate(b, e)
+            spmv_rows("interior", mat, op->interior_rows, b, e, x, y);
+        }
+
+        for (int b = 0; b < op->n_boundary; b += op->task_rows) {
+            int e = b + op->task_rows < op->n_boundary ? b + op->task_rows : op->n_boundary;
+            #pragma omp task depend(in: ghosts_ready) firstprivate(b, e)
+            spmv_rows("boundary", mat, op->boundary_rows, b, e, x, y);
+        }
+    }
+    (void)ghosts_ready;
+    return comm_time;
+}
+
+const char* overlap_mode_name(int mode) {
+    return mode == OVERLAP_P2P ? "p2p" : mode == OVERLAP_TASK ? "task" : "none";
+}
+
+void free_overlap_plan(OverlapPlan *op) {
+    if (op) {
+        free(op->interior_rows);
+        free(op->boundary_rows);
+        free(op->neighbors);
+        free(op->reqs);
+        free(op);
+    }
+}
@@ -0,0 +1,214 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <mpi.h>
+#include "structures.h"
+#include "repartition.h"
+#include "alloc.h"
+
+void setup_communication_pattern(LocalCSR *m, CommInfo *c, MPI_Comm mc, int Ng);
+void perform_ghost_exchange(CommInfo *c, double *x, int dim);
+void compute_spmv(LocalCSR *m, double *x, double *y);
+void free_comm_info(CommInfo *comm);
+
+int partition_owner(const Partition *part, int g, int size) {
+    if (!part) return GET_OWNER(g, size);
+    // Ricerca binaria sui confini dei blocchi
+    int lo = 0, hi = size - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (part->first_row[mid] <= g) lo = mid;
+        else hi = mid - 1;
+    }
+    return lo;
+}
+
+int partition_local(const Partition *part, int g, int size) {
+    if (!part) return GET_LOCAL_IDX(g, size);
+    return g - part->first_row[partition_owner(part, g, size)];
+}
+
+int partition_global(const Partition *part, int local, int rank, int size) {
+    if (!part) return rank + local * size;
+    return part->first_row[rank] + local;
+}
+
+int partition_count(const Partition *part, int n_glob, int rank, int size) {
+    if (!part) return (n_glob - rank + size - 1) / size;
+    return part->first_row[rank + 1] - part->first_row[rank];
+}
+
+double repartition_measure(LocalCSR *mat, CommInfo *comm, int x_dim, int n_iter) {
+    double *x = alloc_zeroed(x_dim + comm->num_ghosts, sizeof(double));
+    double *y = alloc_zeroed(mat->n_local_rows, sizeof(double));
+    for (int i = 0; i < x_dim; i++) x[i] = 1.0;
+
+    double t_compute = 0.0;
+    for (int k = 0; k < n_iter; k++) {
+        perform_ghost_exchange(comm, x, x_dim);
+        double t = MPI_Wtime();
+        compute_spmv(mat, x, y);
+        t_compute += MPI_Wtime() - t;
+    }
+    free(x);
+    free(y);
+    return n_iter > 0 ? t_compute / n_iter : 0.0;
+}
+
+// Confini dei blocchi: prefisso del costo globale diviso in parti uguali.
+// Ogni rank fa gli stessi calcoli sugli stessi dati, quindi ottiene la stessa partizione
+static Partition* balanced_blocks(const double *cost, int n_glob, int size) {
+    Partition *part = malloc(sizeof(Partition));
+    part->n_glob = n_glob;
+    part->first_row = malloc((size + 1) * sizeof(int));
+
+    double total = 0.0;
+    for (int g = 0; g < n_glob; g++) total += cost[g];
+    int uniform = !(total > 0.0);   // nessun tempo misurato: righe in parti uguali
+    if (uniform) total = n_glob;
+
+    double prefix = 0.0;
+    int p = 1;
+    part->first_row[0] = 0;
+    for (int g = 0; g < n_glob && p < size; g++) {
+        // La riga g va al blocco successivo se il prefisso ha già superato il
+        // traguardo del blocco corrente
+        while (p < size && prefix >= total * p / size) part->first_row[p++] = g;
+        prefix += uniform ? 1.0 : cost[g];
+    }
+    while (p < size) part->first_row[p++] = n_glob;
+    part->first_row[size] = n_glob;
+    return part;
+}
+
+Partition* repartition_by_cost(LocalCSR *mat, CommInfo *comm, double my_time,
+                               int M_glob, int N_glob, long long *rows_moved) {
+    int rank, size;
+    MPI_Comm_rank(comm->mpi_comm, &rank);
+    MPI_Comm_size(comm->mpi_comm, &size);
+    int x_dim = partition_count(mat->part, N_glob, rank, size);
+
+    // Costo di ogni riga: tempo del rank ripartito sulle righe in proporzione
+    // a nonzeri + costo fisso. Vettore globale ricostruito con una riduzione
+    double my_weight = 0.0;
+    for (int i = 0; i < mat->n_local_rows; i++) {
+        my_weight += (mat->row_ptr[i+1] - mat->row_ptr[i]) + REPART_ROW_WEIGHT;
+    }
+    double scale = my_weight > 0.0 ? my_time / my_weight : 0.0;
+    double *cost = calloc(M_glob, sizeof(double));
+    for (int i = 0; i < mat->n_local_rows; i++) {
+        int g = partition_global(mat->part, i, rank, size);
+        cost[g] = ((mat->row_ptr[i+1] - mat->row_ptr[i]) + REPART_ROW_WEIGHT) * scale;
+    }
+    MPI_Allreduce(MPI_IN_PLACE, cost, M_glob, MPI_DOUBLE, MPI_SUM, comm->mpi_comm);
+    Partition *part = balanced_blocks(cost, M_glob, size);
+    free(cost);
+
+    // Conteggi per destinazione: righe e nonzeri
+    int *send_cnt = calloc(2 * size, sizeof(int));
+    int *recv_cnt = malloc(2 * size * sizeof(int));
+    long long my_moved = 0;
+    for (int i = 0; i < mat->n_local_rows; i++) {
+        int dest = partition_owner(part, partition_global(mat->part, i, rank, size), size);
+        send_cnt[2 * dest]++;
+        send_cnt[2 * dest + 1] += (int)(mat->row_ptr[i+1] - mat->row_ptr[i]);
+        if (dest != rank) my_moved++;
+    }
+    MPI_Alltoall(send_cnt, 2, MPI_INT, recv_cnt, 2, MPI_INT, comm->mpi_comm);
+    MPI_Allreduce(&my_moved, rows_moved, 1, MPI_LONG_LONG, MPI_SUM, comm->mpi_comm);
+
+    int *s_rows = malloc(size * sizeof(int)), *r_rows = malloc(size * sizeof(int));
+    int *s_nz = malloc(size * sizeof(int)), *r_nz = malloc(size * sizeof(int));
+    int *s_rd = malloc(size * sizeof(int)), *r_rd = malloc(size * sizeof(int));
+    int *s_zd = malloc(size * sizeof(int)), *r_zd = malloc(size * sizeof(int));
+    int tot_s_rows = 0, tot_r_rows = 0;
+    spmv_nnz_t tot_s_nz = 0, tot_r_nz = 0;
+    for (int p = 0; p < size; p++) {
+        // Metadati di riga: coppie (indice globale, lunghezza)
+        s_rows[p] = 2 * send_cnt[2 * p];     r_rows[p] = 2 * recv_cnt[2 * p];
+        s_nz[p] = send_cnt[2 * p + 1];       r_nz[p] = recv_cnt[2 * p + 1];
+        s_rd[p] = tot_s_rows; tot_s_rows += s_rows[p];
+        r_rd[p] = tot_r_rows; tot_r_rows += r_rows[p];
+        s_zd[p] = tot_s_nz;   tot_s_nz += s_nz[p];
+        r_zd[p] = tot_r_nz;   tot_r_nz += r_nz[p];
+    }
+    // Alltoallv ha conteggi e spiazzamenti int: i nonzeri migrati devono starci
+    if (mat->n_local_nz > INT_MAX || tot_r_nz > INT_MAX) {
+        fprintf(stderr, "Error: repartition moves more than 2^31 nonzeros on rank %d\n", rank);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    // Righe impacchettate per destinazione, colonne riportate a indici globali
+    int *meta = malloc((tot_s_rows + 1) * sizeof(int));
+    int *cols = malloc((tot_s_nz + 1) * sizeof(int));
+    double *vals = malloc((tot_s_nz + 1) * sizeof(double));
+    int *mpos = malloc(size * sizeof(int)), *zpos = malloc(size * sizeof(int));
+    memcpy(mpos, s_rd, size * sizeof(int));
+    memcpy(zpos, s_zd, size * sizeof(int));
+    for (int i = 0; i < mat->n_local_rows; i++) {
+        int g = partition_global(mat->part, i, rank, size);
+        int dest = partition_owner(part, g, size);
+        int len = (int)(mat->row_ptr[i+1] - mat->row_ptr[i]);
+        meta[mpos[dest]++] = g;
+        meta[mpos[dest]++] = len;
+        for (spmv_nnz_t j = mat->row_ptr[i]; j < mat->row_ptr[i+1]; j++) {
+            int c = mat->col_ind[j];
+            cols[zpos[dest]] = c < x_dim ? partition_global(mat->part, c, rank, size)
+                                         : comm->ghost_globals[c - x_dim];
+            vals[zpos[dest]++] = mat->val[j];
+        }
+    }
+
+    int *r_meta = malloc((tot_r_rows + 1) * sizeof(int));
+    int *r_cols = malloc((tot_r_nz + 1) * sizeof(int));
+    double *r_vals = malloc((tot_r_nz + 1) * sizeof(double));
+    MPI_Alltoallv(meta, s_rows, s_rd, MPI_INT, r_meta, r_rows, r_rd, MPI_INT, comm->mpi_comm);
+    MPI_Alltoallv(cols, s_nz, s_zd, MPI_INT, r_cols, r_nz, r_zd, MPI_INT, comm->mpi_comm);
+    MPI_Alltoallv(vals, s_nz, s_zd, MPI_DOUBLE, r_vals, r_nz, r_zd, MPI_DOUBLE, comm->mpi_comm);
+    free(meta); free(cols); free(vals); free(mpos); free(zpos);
+
+    // Nuovo CSR locale: righe in ordine globale nel blocco del rank
+    int n_rows = part->first_row[rank + 1] - part->first_row[rank];
+    spmv_nnz_t *row_ptr = alloc_zeroed(n_rows + 1, sizeof(spmv_nnz_t));
+    for (int k = 0; k < tot_r_rows; k += 2) {
+        row_ptr[r_meta[k] - part->first_row[rank] + 1] = r_meta[k + 1];
+    }
+    for (int i = 0; i < n_rows; i++) row_ptr[i+1] += row_ptr[i];
+
+    int *col_ind = alloc_array((size_t)(tot_r_nz > 0 ? tot_r_nz : 1) * sizeof(int));
+    double *val = alloc_array((size_t)(tot_r_nz > 0 ? tot_r_nz : 1) * sizeof(double));
+    int src = 0;
+    for (int k = 0; k < tot_r_rows; k += 2) {
+        spmv_nnz_t dst = row_ptr[r_meta[k] - part->first_row[rank]];
+        memcpy(col_ind + dst, r_cols + src, r_meta[k + 1] * sizeof(int));
+        memcpy(val + dst, r_vals + src, r_meta[k + 1] * sizeof(double));
+        src += r_meta[k + 1];
+    }
+    free(r_meta); free(r_cols); free(r_vals);
+    free(send_cnt); free(recv_cnt);
+    free(s_rows); free(r_rows); free(s_nz); free(r_nz);
+    free(s_rd); free(r_rd); free(s_zd); free(r_zd);
+
+    free(mat->row_ptr);
+    free(mat->col_ind);
+    free(mat->val);
+    mat->n_local_rows = n_rows;
+    mat->n_local_nz = tot_r_nz;
+    mat->row_ptr = row_ptr;
+    mat->col_ind = col_ind;
+    mat->val = val;
+    mat->part = part;
+
+    // Schema di comunicazione ricostruito sulla nuova partizione
+    free_comm_info(comm);
+    setup_communication_pattern(mat, comm, comm->mpi_comm, N_glob);
+    return part;
+}
+
+void free_partition(Partition *part) {
+    if (part) {
+        free(part->first_row);
+        free(part);
+    }
+}
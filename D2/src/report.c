@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+#include "report.h"
+#include "bench.h"
+
+#define REPORT_PHASES 3
+
+static char* format_runs(const ReportInfo *info, const double *total, const double *comm,
+                         int repeats, int *len) {
+    char *buf = malloc((size_t)repeats * REPORT_LINE_MAX + 1);
+    int n = 0;
+    for (int r = 0; r < repeats; r++) {
+        n += snprintf(buf + n, REPORT_LINE_MAX, "%s,%d,%d,%d,%.9f,%.9f,%lld,%d,%lld\n",
+                      info->name, info->rank, info->size, r, total[r], comm[r],
+                      info->local_nz, info->ghosts, info->flops);
+    }
+    *len = n;
+    return buf;
+}
+
+void report_runs(const ReportInfo *info, const double *total, const double *comm,
+                 int repeats, const char *file) {
+    int len;
+    char *buf = format_runs(info, total, comm, repeats, &len);
+    long long header_len = (long long)strlen(REPORT_CSV_HEADER);
+
+    if (file) {
+        // Ogni rank scrive alla sua posizione: somma prefissa delle lunghezze
+        long long my_len = len, offset = 0;
+        MPI_Exscan(&my_len, &offset, 1, MPI_LONG_LONG, MPI_SUM, info->mpi_comm);
+        if (info->rank == 0) offset = 0;
+        offset += header_len;
+
+        MPI_File fh;
+        if (MPI_File_open(info->mpi_comm, file, MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                          MPI_INFO_NULL, &fh) != MPI_SUCCESS) {
+            if (info->rank == 0) fprintf(stderr, "Error: cannot open report file %s\n", file);
+            free(buf);
+            return;
+        }
+        MPI_File_set_size(fh, 0);
+        if (info->rank == 0) {
+            MPI_File_write_at(fh, 0, REPORT_CSV_HEADER, (int)header_len, MPI_CHAR, MPI_STATUS_IGNORE);
+        }
+        MPI_File_write_at_all(fh, (MPI_Offset)offset, buf, len, MPI_CHAR, MPI_STATUS_IGNORE);
+        MPI_File_close(&fh);
+        if (info->rank == 0) fprintf(stderr, "Per-run records written to %s (MPI-IO)\n", file);
+        free(buf);
+        return;
+    }
+
+    // Un solo Gatherv del testo già formattato: nessun interleaving tra nodi
+    int *lens = NULL, *displs = NULL;
+    char *all = NULL;
+    if (info->rank == 0) {
+        lens = malloc(info->size * sizeof(int));
+        displs = malloc(info->size * sizeof(int));
+    }
+    MPI_Gather(&len, 1, MPI_INT, lens, 1, MPI_INT, 0, info->mpi_comm);
+    if (info->rank == 0) {
+        long total_len = 0;
+        for (int p = 0; p < info->size; p++) {
+            displs[p] = (int)total_len;
+            total_len += lens[p];
+        }
+        all = malloc(total_len + 1);
+    }
+    MPI_Gatherv(buf, len, MPI_CHAR, all, lens, displs, MPI_CHAR, 0, info->mpi_comm);
+
+    if (info->rank == 0) {
+        fputs(REPORT_CSV_HEADER, stdout);
+        fwrite(all, 1, displs[info->size - 1] + lens[info->size - 1], stdout);
+        fflush(stdout);
+        free(all);
+        free(lens);
+        free(displs);
+    }
+    free(buf);
+}
+
+void report_phase_stats(const ReportInfo *info, const double *total, const double *comm, int repeats) {
+    int rank = info->rank, size = info->size;
+
+    // Campioni della fase per run: [fase][run]
+    double *phase = malloc((size_t)REPORT_PHASES * repeats * sizeof(double));
+    for (int r = 0; r < repeats; r++) {
+        phase[r] = total[r];
+        phase[repeats + r] = comm[r];
+        phase[2 * repeats + r] = total[r] - comm[r];
+    }
+
+    // Statistiche locali ridotte: min, somma, max, P90 del rank
+    double loc_min[REPORT_PHASES], loc_sum[REPORT_PHASES], loc_max[REPORT_PHASES], loc_p90[REPORT_PHASES];
+    for (int f = 0; f < REPORT_PHASES; f++) {
+        BenchStats s;
+        bench_compute_stats(phase + f * repeats, repeats, &s);
+        loc_min[f] = s.min;
+        loc_max[f] = s.max;
+        loc_sum[f] = s.mean * repeats;
+        loc_p90[f] = s.p90;
+    }
+    double g_min[REPORT_PHASES], g_sum[REPORT_PHASES], g_max[REPORT_PHASES], g_p90[REPORT_PHASES];
+    MPI_Reduce(loc_min, g_min, REPORT_PHASES, MPI_DOUBLE, MPI_MIN, 0, info->mpi_comm);
+    MPI_Reduce(loc_sum, g_sum, REPORT_PHASES, MPI_DOUBLE, MPI_SUM, 0, info->mpi_comm);
+    MPI_Reduce(loc_max, g_max, REPORT_PHASES, MPI_DOUBLE, MPI_MAX, 0, info->mpi_comm);
+    MPI_Reduce(loc_p90, g_p90, REPORT_PHASES, MPI_DOUBLE, MPI_MAX, 0, info->mpi_comm);
+
+    // P90 di sistema: per ogni run il rank più lento, in una sola riduzione
+    double *run_max = (rank == 0) ? malloc((size_t)REPORT_PHASES * repeats * sizeof(double)) : NULL;
+    MPI_Reduce(phase, run_max, REPORT_PHASES * repeats, MPI_DOUBLE, MPI_MAX, 0, info->mpi_comm);
+
+    if (rank == 0) {
+        const char *names[REPORT_PHASES] = {"elapsed", "comm", "compute"};
+        // Niente virgole: test.sh tiene tutte le righe che ne contengono
+        printf("\n=== PHASE STATISTICS (ms over %d ranks x %d runs) ===\n", size, repeats);
+        printf("%-10s %12s %12s %12s %12s %12s\n", "phase", "min", "mean", "max", "p90_rank_max", "p90_system");
+        for (int f = 0; f < REPORT_PHASES; f++) {
+            BenchStats s;
+            bench_compute_stats(run_max + f * repeats, repeats, &s);
+            printf("%-10s %12.6f %12.6f %12.6f %12.6f %12.6f\n", names[f], g_min[f] * 1e3,
+                   g_sum[f] / ((double)size * repeats) * 1e3, g_max[f] * 1e3, g_p90[f] * 1e3, s.p90 * 1e3);
+        }
+        free(run_max);
+    }
+    free(phase);
+}
+
+void report_ensemble(const ReportInfo *info, int group, int repeats, double loop_time) {
+    EnsembleRecord rec;
+    memset(&rec, 0, sizeof(rec));
+    snprintf(rec.name, sizeof(rec.name), "%s", info->name);
+    rec.group = group;
+    rec.size = info->size;
+    rec.repeats = repeats;
+    double my_flops = (double)info->flops;
+    MPI_Reduce(&loop_time, &rec.loop_time, 1, MPI_DOUBLE, MPI_MAX, 0, info->mpi_comm);
+    MPI_Reduce(&my_flops, &rec.flops, 1, MPI_DOUBLE, MPI_SUM, 0, info->mpi_comm);
+
+    // Comunicatore dei soli rank 0 dei gruppi, ordinato per gruppo
+    MPI_Comm leaders;
+    MPI_Comm_split(MPI_COMM_WORLD, info->rank == 0 ? 0 : MPI_UNDEFINED, group, &leaders);
+    if (leaders == MPI_COMM_NULL) return;
+
+    int l_rank, n_groups;
+    MPI_Comm_rank(leaders, &l_rank);
+    MPI_Comm_size(leaders, &n_groups);
+    EnsembleRecord *all = (l_rank == 0) ? malloc(n_groups * sizeof(EnsembleRecord)) : NULL;
+    MPI_Gather(&rec, sizeof(rec), MPI_BYTE, all, sizeof(rec), MPI_BYTE, 0, leaders);
+    MPI_Comm_free(&leaders);
+    if (l_rank != 0) return;
+
+    // Gruppi concorrenti: il throughput del job è la somma di quelli dei gruppi
+    double tot_rate = 0.0, tot_gflops = 0.0, max_time = 0.0;
+    long long tot_spmv = 0;
+    int tot_ranks = 0;
+    printf("\n=== ENSEMBLE THROUGHPUT ===\n");
+    printf("Group,Matrix_Name,Num_Processes,SpMVs,Loop_Time,SpMVs_per_s,GFLOPs\n");
+    for (int g = 0; g < n_groups; g++) {
+        EnsembleRecord *e = &all[g];
+        double rate = e->loop_time > 0.0 ? e->repeats / e->loop_time : 0.0;
+        double gflops = rate * e->flops / 1e9;
+        printf("%d,%s,%d,%d,%.9f,%.2f,%.4f\n", e->group, e->name, e->size, e->repeats,
+               e->loop_time, rate, gflops);
+        tot_rate += rate;
+        tot_gflops += gflops;
+        tot_spmv += e->repeats;
+        tot_ranks += e->size;
+        if (e->loop_time > max_time) max_time = e->loop_time;
+    }
+    printf("total,%d_groups,%d,%lld,%.9f,%.2f,%.4f\n", n_groups, tot_ranks, tot_spmv, max_time,
+           tot_rate, tot_gflops);
+    printf("===========================\n");
+    fflush(stdout);
+    free(all);
+}
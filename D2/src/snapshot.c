@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <mpi.h>
+#include "snapshot.h"
+#include "alloc.h"
+#include "trace.h"
+
+// Array di CommInfo nell'ordine del file, con la lunghezza in elementi int
+static int comm_arrays(const CommInfo *comm, int size, int **arr[6], int len[6]) {
+    arr[0] = (int**)&comm->send_counts;    len[0] = size;
+    arr[1] = (int**)&comm->recv_counts;    len[1] = size;
+    arr[2] = (int**)&comm->sdispls;        len[2] = size;
+    arr[3] = (int**)&comm->rdispls;        len[3] = size;
+    arr[4] = (int**)&comm->export_indices; len[4] = comm->total_to_send;
+    arr[5] = (int**)&comm->ghost_globals;  len[5] = comm->num_ghosts;
+    return 6;
+}
+
+// Lettura e scrittura collettive di count elementi anche oltre INT_MAX
+static void read_large(MPI_File fh, MPI_Offset pos, void *buf, spmv_nnz_t count, MPI_Datatype base) {
+    int n;
+    MPI_Datatype t = large_count_type(count, base, &n);
+    MPI_File_read_at_all(fh, pos, buf, n, t, MPI_STATUS_IGNORE);
+    free_large_count_type(t, base);
+}
+
+static void write_large(MPI_File fh, MPI_Offset pos, const void *buf, spmv_nnz_t count, MPI_Datatype base) {
+    int n;
+    MPI_Datatype t = large_count_type(count, base, &n);
+    MPI_File_write_at_all(fh, pos, buf, n, t, MPI_STATUS_IGNORE);
+    free_large_count_type(t, base);
+}
+
+static MPI_Offset table_bytes(const SnapshotHeader *hdr) {
+    MPI_Offset b = (MPI_Offset)sizeof(SnapshotHeader) + (MPI_Offset)hdr->size * sizeof(int64_t);
+    if (hdr->kind == SNAPSHOT_BLOCKS) b += (MPI_Offset)(hdr->size + 1) * sizeof(int32_t);
+    return b;
+}
+
+void snapshot_stamp_source(const char *matrix_file, MPI_Comm mpi_comm, SnapshotHeader *hdr) {
+    int rank;
+    MPI_Comm_rank(mpi_comm, &rank);
+    int64_t stamp[2] = {0, 0};
+    struct stat st;
+    if (rank == 0 && stat(matrix_file, &st) == 0) {
+        stamp[0] = (int64_t)st.st_size;
+        stamp[1] = (int64_t)st.st_mtime;
+    }
+    MPI_Bcast(stamp, 2, MPI_INT64_T, 0, mpi_comm);
+    hdr->source_bytes = stamp[0];
+    hdr->source_mtime = stamp[1];
+}
+
+int snapshot_probe(const char *file, MPI_Comm mpi_comm, SnapshotHeader *hdr) {
+    int rank, ok = 0;
+    MPI_Comm_rank(mpi_comm, &rank);
+    if (rank == 0) {
+        FILE *f = fopen(file, "rb");
+        if (f) {
+            ok = fread(hdr, sizeof(SnapshotHeader), 1, f) == 1 &&
+                 memcmp(hdr->magic, SNAPSHOT_MAGIC, 8) == 0;
+            fclose(f);
+        }
+    }
+    MPI_Bcast(&ok, 1, MPI_INT, 0, mpi_comm);
+    if (ok) MPI_Bcast(hdr, sizeof(SnapshotHeader), MPI_BYTE, 0, mpi_comm);
+    return ok;
+}
+
+void snapshot_read(const char *file, MPI_Comm mpi_comm, const SnapshotHeader *hdr,
+                   LocalCSR *mat, CommInfo *comm, Partition **part) {
+    int rank, size;
+    MPI_Comm_rank(mpi_comm, &rank);
+    MPI_Comm_size(mpi_comm, &size);
+
+    MPI_File fh;
+    if (MPI_File_open(mpi_comm, file, MPI_MODE_RDONLY, MPI_INFO_NULL, &fh) != MPI_SUCCESS) {
+        if (rank == 0) fprintf(stderr, "Error: cannot open snapshot %s\n", file);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    TRACE_BEGIN(t_read);
+    int64_t my_off;
+    MPI_File_read_at_all(fh, (MPI_Offset)sizeof(SnapshotHeader) + (MPI_Offset)rank * sizeof(int64_t),
+                         &my_off, (int)sizeof(int64_t), MPI_BYTE, MPI_STATUS_IGNORE);
+
+    *part = NULL;
+    if (hdr->kind == SNAPSHOT_BLOCKS) {
+        *part = malloc(sizeof(Partition));
+        (*part)->n_glob = hdr->N;
+        (*part)->first_row = malloc((size + 1) * sizeof(int));
+        MPI_File_read_at_all(fh, (MPI_Offset)sizeof(SnapshotHeader) + (MPI_Offset)size * sizeof(int64_t),
+                             (*part)->first_row, size + 1, MPI_INT, MPI_STATUS_IGNORE);
+    }
+
+    SnapshotRank rh;
+    MPI_File_read_at_all(fh, (MPI_Offset)my_off, &rh, (int)sizeof(rh), MPI_BYTE, MPI_STATUS_IGNORE);
+    MPI_Offset pos = (MPI_Offset)my_off + sizeof(rh);
+
+    mat->n_local_rows = rh.n_local_rows;
+    mat->n_local_nz = rh.n_local_nz;
+    mat->row_ptr = alloc_array((size_t)(rh.n_local_rows + 1) * sizeof(spmv_nnz_t));
+    mat->col_ind = alloc_array((size_t)rh.n_local_nz * sizeof(int));
+    mat->val = alloc_array((size_t)rh.n_local_nz * sizeof(double));
+    mat->part = *part;
+    MPI_File_read_at_all(fh, pos, mat->row_ptr, rh.n_local_rows + 1, MPI_SPMV_NNZ, MPI_STATUS_IGNORE);
+    pos += (MPI_Offset)(rh.n_local_rows + 1) * sizeof(spmv_nnz_t);
+    read_large(fh, pos, mat->col_ind, mat->n_local_nz, MPI_INT);
+    pos += (MPI_Offset)rh.n_local_nz * sizeof(int);
+    read_large(fh, pos, mat->val, mat->n_local_nz, MPI_DOUBLE);
+    pos += (MPI_Offset)rh.n_local_nz * sizeof(double);
+
+    comm->mpi_comm = mpi_comm;
+    comm->num_ghosts = rh.num_ghosts;
+    comm->total_to_send = rh.total_to_send;
+    comm->exchange_mode = rh.exchange_mode;
+    int **arr[6], len[6];
+    int n_arr = comm_arrays(comm, size, arr, len);
+    // Letture collettive in numero uguale su tutti i rank: gli array assenti
+    // partecipano con zero elementi
+    for (int k = 0; k < n_arr; k++) {
+        int present = (rh.arrays >> k) & 1;
+        int n = present ? len[k] : 0;
+        if (present) *arr[k] = malloc((n > 0 ? n : 1) * sizeof(int));
+        MPI_File_read_at_all(fh, pos, present ? *arr[k] : NULL, n, MPI_INT, MPI_STATUS_IGNORE);
+        pos += (MPI_Offset)n * sizeof(int);
+    }
+    MPI_File_close(&fh);
+    TRACE_END("snapshot_read", t_read);
+
+    // Buffer di scambio: non salvati, solo dimensionati
+    if (comm->send_counts) {
+        comm->send_buffer = malloc((comm->total_to_send > 0 ? comm->total_to_send : 1) * sizeof(double));
+        comm->recv_buffer = malloc((comm->num_ghosts > 0 ? comm->num_ghosts : 1) * sizeof(double));
+    }
+}
+
+long long snapshot_write(const char *file, MPI_Comm mpi_comm, const SnapshotHeader *hdr,
+                         const LocalCSR *mat, const CommInfo *comm, const Partition *part) {
+    int rank, size;
+    MPI_Comm_rank(mpi_comm, &rank);
+    MPI_Comm_size(mpi_comm, &size);
+
+    SnapshotRank rh = {mat->n_local_nz, mat->n_local_rows, comm->num_ghosts,
+                       comm->total_to_send, comm->exchange_mode, 0, 0};
+    int **arr[6], len[6];
+    int n_arr = comm_arrays(comm, size, arr, len);
+    long long my_bytes = sizeof(rh) + (long long)(mat->n_local_rows + 1) * sizeof(spmv_nnz_t)
+                       + (long long)mat->n_local_nz * (sizeof(int) + sizeof(double));
+    for (int k = 0; k < n_arr; k++) {
+        if (*arr[k]) {
+            rh.arrays |= 1 << k;
+            my_bytes += (long long)len[k] * sizeof(int);
+        }
+    }
+
+    // Blocchi in ordine di rank dopo intestazione e tabella
+    long long my_off = 0, total = 0;
+    MPI_Exscan(&my_bytes, &my_off, 1, MPI_LONG_LONG, MPI_SUM, mpi_comm);
+    if (rank == 0) my_off = 0;
+    my_off += table_bytes(hdr);
+    MPI_Allreduce(&my_bytes, &total, 1, MPI_LONG_LONG, MPI_SUM, mpi_comm);
+    total += table_bytes(hdr);
+
+    MPI_File fh;
+    if (MPI_File_open(mpi_comm, file, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &fh) != MPI_SUCCESS) {
+        if (rank == 0) fprintf(stderr, "Error: cannot write snapshot %s\n", file);
+        return 0;
+    }
+    TRACE_BEGIN(t_write);
+    MPI_File_set_size(fh, 0);
+    if (rank == 0) {
+        MPI_File_write_at(fh, 0, hdr, (int)sizeof(SnapshotHeader), MPI_BYTE, MPI_STATUS_IGNORE);
+        if (part) {
+            MPI_File_write_at(fh, (MPI_Offset)sizeof(SnapshotHeader) + (MPI_Offset)size * sizeof(int64_t),
+                              part->first_row, size + 1, MPI_INT, MPI_STATUS_IGNORE);
+        }
+    }
+    int64_t off64 = my_off;
+    MPI_File_write_at_all(fh, (MPI_Offset)sizeof(SnapshotHeader) + (MPI_Offset)rank * sizeof(int64_t),
+                          &off64, (int)sizeof(int64_t), MPI_BYTE, MPI_STATUS_IGNORE);
+
+    MPI_Offset pos = (MPI_Offset)my_off;
+    MPI_File_write_at_all(fh, pos, &rh, (int)sizeof(rh), MPI_BYTE, MPI_STATUS_IGNORE);
+    pos += sizeof(rh);
+    MPI_File_write_at_all(fh, pos, mat->row_ptr, mat->n_local_rows + 1, MPI_SPMV_NNZ, MPI_STATUS_IGNORE);
+    pos += (MPI_Offset)(mat->n_local_rows + 1) * sizeof(spmv_nnz_t);
+    write_large(fh, pos, mat->col_ind, mat->n_local_nz, MPI_INT);
+    pos += (MPI_Offset)mat->n_local_nz * sizeof(int);
+    write_large(fh, pos, mat->val, mat->n_local_nz, MPI_DOUBLE);
+    pos += (MPI_Offset)mat->n_local_nz * sizeof(double);
+    for (int k = 0; k < n_arr; k++) {
+        int n = *arr[k] ? len[k] : 0;
+        MPI_File_write_at_all(fh, pos, *arr[k], n, MPI_INT, MPI_STATUS_IGNORE);
+        pos += (MPI_Offset)n * sizeof(int);
+    }
+    MPI_File_close(&fh);
+    TRACE_END("snapshot_write", t_write);
+    return total;
+}
@@ -0,0 +1,191 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mpi.h>
+#ifdef _OPENMP
+    #include <omp.h>
+#else
+    #define omp_get_thread_num() 0
+    #define omp_get_max_threads() 1
+#endif
+#include "trace.h"
+
+typedef struct {
+    TraceEvent *ev;
+    long count;         // eventi registrati in totale (anche sovrascritti)
+} TraceRing;
+
+int trace_enabled = 0;
+
+static TraceRing *rings = NULL;
+static int n_rings = 0;
+static const char *trace_path = NULL;
+static int trace_per_rank = 0;
+static double clock_offset = 0.0;   // da sottrarre a MPI_Wtime locale per avere il clock del rank 0
+
+// Scarto tra il clock di ogni rank e quello del rank 0 con ping-pong: si
+// tiene il giro più breve, l'errore è al più metà del suo tempo
+static double sync_clock(int rank, int size) {
+    double offset = 0.0;
+    double *offsets = (rank == 0) ? calloc(size, sizeof(double)) : NULL;
+
+    for (int p = 1; p < size; p++) {
+        if (rank == 0) {
+            double best_rtt = 1e30;
+            for (int k = 0; k < TRACE_SYNC_ROUNDS; k++) {
+                double t_remote, t_send = MPI_Wtime();
+                MPI_Send(&t_send, 1, MPI_DOUBLE, p, 0, MPI_COMM_WORLD);
+                MPI_Recv(&t_remote, 1, MPI_DOUBLE, p, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+                double t_recv = MPI_Wtime();
+                if (t_recv - t_send < best_rtt) {
+                    best_rtt = t_recv - t_send;
+                    offsets[p] = t_remote - 0.5 * (t_send + t_recv);
+                }
+            }
+        } else if (rank == p) {
+            for (int k = 0; k < TRACE_SYNC_ROUNDS; k++) {
+                double t;
+                MPI_Recv(&t, 1, MPI_DOUBLE, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+                t = MPI_Wtime();
+                MPI_Send(&t, 1, MPI_DOUBLE, 0, 0, MPI_COMM_WORLD);
+            }
+        }
+    }
+    MPI_Scatter(offsets, 1, MPI_DOUBLE, &offset, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    free(offsets);
+    return offset;
+}
+
+void trace_init(const char *path, int per_rank) {
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    trace_path = path;
+    trace_per_rank = per_rank;
+    n_rings = omp_get_max_threads();
+    rings = calloc(n_rings, sizeof(TraceRing));
+    for (int t = 0; t < n_rings; t++) {
+        rings[t].ev = malloc(TRACE_RING_EVENTS * sizeof(TraceEvent));
+    }
+
+    // Origine comune: MPI_Wtime del rank 0 a questo punto
+    double t0 = MPI_Wtime();
+    MPI_Bcast(&t0, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    clock_offset = sync_clock(rank, size) + t0;
+    trace_enabled = 1;
+}
+
+void trace_event(const char *name, double t_begin, double t_end) {
+    int tid = omp_get_thread_num();
+    if (tid >= n_rings) return;
+    TraceRing *r = &rings[tid];
+    TraceEvent *e = &r->ev[r->count % TRACE_RING_EVENTS];
+    e->name = name;
+    e->t_begin = t_begin;
+    e->t_end = t_end;
+    r->count++;
+}
+
+// Eventi del rank in formato JSON, separati da ",\n"; restituisce la lunghezza
+static long format_events(int rank, char **out, long *dropped) {
+    long n_total = 0;
+    *dropped = 0;
+    for (int t = 0; t < n_rings; t++) {
+        long kept = rings[t].count < TRACE_RING_EVENTS ? rings[t].count : TRACE_RING_EVENTS;
+        n_total += kept;
+        *dropped += rings[t].count - kept;
+    }
+
+    long cap = (n_total + 2) * 160 + 256;
+    char *buf = malloc(cap);
+    long len = snprintf(buf, cap, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"rank %d\"}}",
+                        rank, rank);
+
+    for (int t = 0; t < n_rings; t++) {
+        long first = rings[t].count > TRACE_RING_EVENTS ? rings[t].count - TRACE_RING_EVENTS : 0;
+        for (long k = first; k < rings[t].count; k++) {
+            TraceEvent *e = &rings[t].ev[k % TRACE_RING_EVENTS];
+            // Chrome trace: microsecondi, eventi completi ("X")
+            len += snprintf(buf + len, cap - len,
+                            ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                            e->name, rank, t, (e->t_begin - clock_offset) * 1e6,
+                            (e->t_end - e->t_begin) * 1e6);
+        }
+    }
+    *out = buf;
+    return len;
+}
+
+void trace_finalize(void) {
+    if (!trace_enabled) return;
+    trace_enabled = 0;
+
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    char *events;
+    long dropped;
+    long len = format_events(rank, &events, &dropped);
+
+    long total_dropped = 0;
+    MPI_Reduce(&dropped, &total_dropped, 1, MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+
+    if (trace_per_rank) {
+        char name[512];
+        snprintf(name, sizeof(name), "%s.rank%d.json", trace_path, rank);
+        FILE *f = fopen(name, "w");
+        if (f) {
+            fprintf(f, "{\"traceEvents\":[\n%s\n],\"displayTimeUnit\":\"ms\"}\n", events);
+            fclose(f);
+        } else {
+            fprintf(stderr, "Rank %d: cannot write trace file %s\n", rank, name);
+        }
+    } else {
+        // Un solo file: il rank 0 raccoglie il testo già formattato
+        int my_len = (int)len;
+        int *lens = (rank == 0) ? malloc(size * sizeof(int)) : NULL;
+        int *displs = (rank == 0) ? malloc(size * sizeof(int)) : NULL;
+        MPI_Gather(&my_len, 1, MPI_INT, lens, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+        char *all = NULL;
+        if (rank == 0) {
+            long total = 0;
+            for (int p = 0; p < size; p++) {
+                displs[p] = (int)total;
+                total += lens[p];
+            }
+            all = malloc(total + 1);
+        }
+        MPI_Gatherv(events, my_len, MPI_CHAR, all, lens, displs, MPI_CHAR, 0, MPI_COMM_WORLD);
+
+        if (rank == 0) {
+            FILE *f = fopen(trace_path, "w");
+            if (f) {
+                fprintf(f, "{\"traceEvents\":[\n");
+                for (int p = 0; p < size; p++) {
+                    if (p > 0) fprintf(f, ",\n");
+                    fwrite(all + displs[p], 1, lens[p], f);
+                }
+                fprintf(f, "\n],\"displayTimeUnit\":\"ms\"}\n");
+                fclose(f);
+            } else {
+                fprintf(stderr, "Error: cannot write trace file %s\n", trace_path);
+            }
+            free(all);
+            free(lens);
+            free(displs);
+        }
+    }
+
+    if (rank == 0) {
+        fprintf(stderr, "Trace: written to %s%s (%ld events overwritten in the ring buffers)\n",
+                trace_path, trace_per_rank ? ".rank<N>.json" : "", total_dropped);
+    }
+
+    free(events);
+    for (int t = 0; t < n_rings; t++) free(rings[t].ev);
+    free(rings);
+    rings = NULL;
+}